@@ -3,8 +3,17 @@
 #include <stddef.h>
 #include <string.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define X86_DISPATCH  // avx2 paths picked at runtime, no build flags needed
+#endif
+
 #define ARRAY_LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+// https://www.nesdev.org/wiki/PPU_rendering
+#define DOTS_PER_SCANLINE 341
+#define SCANLINES_PER_FRAME 262  // -1 (pre-render) through 260
+
 static const uint8_t system_colors[][3] = {
     {0x80, 0x80, 0x80}, {0x00, 0x3D, 0xA6}, {0x00, 0x12, 0xB0}, {0x44, 0x00, 0x96}, {0xA1, 0x00, 0x5E},
     {0xC7, 0x00, 0x28}, {0xBA, 0x06, 0x00}, {0x8C, 0x17, 0x00}, {0x5C, 0x2F, 0x00}, {0x10, 0x45, 0x00},
@@ -33,6 +42,10 @@ inline static uint8_t bus_read(const C2C02 *const c, const uint16_t addr) {
     if (addr >= 0x3F00) {
         return c->palette_ram[mirror_palette_ram_addr(addr)];
     }
+    const uint8_t *const page = c->bus_pages ? c->bus_pages[(addr & 0x3FFF) >> C2C02_BUS_PAGE_BITS] : NULL;
+    if (page) {
+        return page[addr & (C2C02_BUS_PAGE_SIZE - 1)];
+    }
     return c->bus->read(c->bus_ctx, addr);
 }
 
@@ -41,6 +54,10 @@ inline static void bus_write(C2C02 *const c, uint16_t addr, uint8_t val) {
         c->palette_ram[mirror_palette_ram_addr(addr)] = val;
         return;
     }
+    if (addr < 0x2000) {  // chr-ram
+        const uint16_t tile = addr >> 4;
+        c->chr_cache.valid[tile >> 6] &= ~(1ull << (tile & 63));
+    }
     c->bus->write(c->bus_ctx, addr, val);
 }
 
@@ -249,13 +266,17 @@ inline static uint8_t get_palette_num(uint8_t attribute_value, uint8_t coarse_x,
     return (attribute_value >> shift) & 0b11;
 }
 
-inline static void draw_pixel(const C2C02 *const c, const uint8_t x, const uint8_t y, uint8_t system_color) {
-    if (c->draw_pixel) {
-        if (c->mask.grayscale) {
-            system_color &= 0xF0;
-        }
-        const uint8_t *const color = system_colors[system_color];
-        c->draw_pixel(c->draw_ctx, x, y, color[0], color[1], color[2]);
+/** framebuffer pixel for the given system color, under the current mask */
+inline static uint16_t get_pixel(const C2C02 *const c, uint8_t system_color) {
+    if (c->mask.grayscale) {
+        system_color &= 0x30;
+    }
+    return ((c->mask.u8 & 0xE0) << (C2C02_PIXEL_EMPHASIS_SHIFT - 5)) | (system_color & C2C02_PIXEL_COLOR_MASK);
+}
+
+inline static void draw_pixel(const C2C02 *const c, const uint8_t x, const uint8_t y, const uint8_t system_color) {
+    if (c->framebuffer) {
+        c->framebuffer[(y * C2C02_WIDTH) + x] = get_pixel(c, system_color);
     }
 }
 
@@ -268,6 +289,44 @@ static uint8_t bit_reverse(uint8_t bits) {
     return ret;
 }
 
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "pixel rows are handled as uint64_t, first pixel lowest");
+
+/** one byte per bit of a bitplane, 0 or 1, leftmost (most significant) bit in the lowest byte */
+inline static uint64_t spread_bitplane(const uint8_t plane) {
+    const uint64_t bits = (plane * 0x0101010101010101ull) & 0x0102040810204080ull;  // byte n keeps bit 7-n
+    return ((bits + 0x7F7F7F7F7F7F7F7Full) & 0x8080808080808080ull) >> 7;
+}
+
+/** expands a row of pattern bitplanes into 2b colors, leftmost pixel first */
+static void decode_row(const uint8_t lo, const uint8_t hi, uint8_t pixels[8]) {
+    const uint64_t colors = spread_bitplane(lo) | (spread_bitplane(hi) << 1);
+    memcpy(pixels, &colors, sizeof(colors));
+}
+
+/** the tile holding the given pattern table address, read and decoded on first use */
+static const _c2C02_tile *get_tile(C2C02 *const c, const uint16_t addr) {
+    typeof(&c->chr_cache) const cache = &c->chr_cache;
+    const uint16_t n = (addr >> 4) & (ARRAY_LEN(cache->tiles) - 1);
+    _c2C02_tile *const tile = &cache->tiles[n];
+    if (!(cache->valid[n >> 6] & (1ull << (n & 63)))) {
+        for (int row = 0; row < 8; row++) {
+            const uint8_t lo = bus_read(c, (n << 4) | row);
+            const uint8_t hi = bus_read(c, (n << 4) | 8 | row);
+            tile->planes[0][row][0] = lo;
+            tile->planes[0][row][1] = hi;
+            tile->planes[1][row][0] = bit_reverse(lo);
+            tile->planes[1][row][1] = bit_reverse(hi);
+            decode_row(lo, hi, tile->pixels[row]);
+        }
+        cache->valid[n >> 6] |= 1ull << (n & 63);
+    }
+    return tile;
+}
+
+void c2C02_invalidate_chr(C2C02 *const c) {
+    memset(c->chr_cache.valid, 0, sizeof(c->chr_cache.valid));
+}
+
 /* https://www.nesdev.org/wiki/PPU_nametables
 Conceptually, the PPU does this 33 times for each scanline:
 
@@ -330,7 +389,7 @@ static void _load_shifters(C2C02 *const c) {
 
 // 240-260: idle except setting vblank
 static void _non_render_scanlines(C2C02 *const c) {
-    const int clocks_since_status = c->clocks - c->last_status_read_clocks;
+    const uint64_t clocks_since_status = c->clocks - c->last_status_read_clocks;
 
     // https://www.nesdev.org/wiki/PPU_frame_timing#VBL_Flag_Timing
     // Reading one PPU clock before reads it as clear and never sets the flag or generates NMI for that frame. Reading
@@ -353,41 +412,164 @@ static void _non_render_scanlines(C2C02 *const c) {
     }
 }
 
-static void _render_scanlines(C2C02 *const c) {
-    // Todo - skip certain loads and shifts depending on if rendering enabled
-    if ((c->scanline == 0) && (c->dot == 0) && c->mask.show_background && (c->frames & 1)) {
-        c->dot++;  // skip (0,0) on bg-enabled + odd-frame
+inline static void _shift_bg(C2C02 *const c) {
+    c->bg_reg.shifters.attr.hi <<= 1;
+    c->bg_reg.shifters.attr.lo <<= 1;
+    c->bg_reg.shifters.pattern.hi <<= 1;
+    c->bg_reg.shifters.pattern.lo <<= 1;
+}
+
+inline static void _fetch_nt(C2C02 *const c) {
+    c->bg_reg.next.nt = bus_read(c, 0x2000 | (c->vram_address._u16 & 0xFFF));
+}
+
+inline static void _fetch_at(C2C02 *const c) {
+    const uint8_t attr_byte = bus_read(c, get_attribute_table_address(0x2000 | (c->vram_address._u16 & 0xFFF)));
+    c->bg_reg.next.attr = get_palette_num(attr_byte, c->vram_address.coarse_x, c->vram_address.coarse_y);
+}
+
+inline static const _c2C02_tile *_get_bg_tile(C2C02 *const c) {
+    return get_tile(c, get_pattern_table_address(0, 0, c->bg_reg.next.nt, c->ctrl.background_pattern_table));
+}
+
+inline static void _fetch_pattern(C2C02 *const c, const uint8_t plane) {
+    uint8_t *const dest = plane ? &c->bg_reg.next.pattern.hi : &c->bg_reg.next.pattern.lo;
+    *dest = _get_bg_tile(c)->planes[0][c->vram_address.fine_y][plane];
+}
+
+/** fills secondary oam with the sprites on the current scanline, to be drawn on the next one */
+static void _eval_sprites(C2C02 *const c) {
+    // Todo - load sprites into secondary OAM piecewise
+    c->sprite_reg.n = 0;
+    c->sprite_reg.sprite0_present = false;
+    for (size_t i = 0; i < ARRAY_LEN(c->oam.sprites); i++) {
+        const _c2C02_sprite *const sprite = &c->oam.sprites[i];
+        const int height = c->ctrl.sprite_size ? 16 : 8;
+        if ((c->scanline >= sprite->y) && (c->scanline < (sprite->y + height))) {
+            if (i == 0) {
+                c->sprite_reg.sprite0_present = true;
+            }
+            c->oam2.sprites[c->sprite_reg.n++] = *sprite;
+            if (c->sprite_reg.n >= 8) {
+                break;  // Todo - buggy sprite overflow...
+            }
+        }
+    }
+}
+
+static void _fetch_sprite(C2C02 *const c, const uint8_t oam2_idx, const uint8_t plane) {
+    const _c2C02_sprite *const sprite = &c->oam2.sprites[oam2_idx];
+    typeof(&c->sprite_reg.shifters[oam2_idx]) const shifter = &c->sprite_reg.shifters[oam2_idx];
+
+    uint8_t *const dest = (plane) ? &shifter->pattern_hi : &shifter->pattern_lo;
+
+    shifter->attr = sprite->attributes.u8;
+    shifter->x = sprite->x;
+
+    // shifters shift out to the right, so unflipped sprites use the bit reversed planes
+    const int reversed = !sprite->attributes.flip_horizontal;
+    if (c->ctrl.sprite_size == 0) {
+        const uint8_t fine_y =
+            sprite->attributes.flip_vertical ? (7 - (c->scanline - sprite->y)) : (c->scanline - sprite->y);
+        const _c2C02_tile *const tile =
+            get_tile(c, get_pattern_table_address(0, 0, sprite->tile, c->ctrl.sprite_pattern_table));
+        *dest = tile->planes[reversed][fine_y & 7][plane];
+    } else {  // 8x16 sprites
+        const uint8_t y =
+            sprite->attributes.flip_vertical ? (15 - (c->scanline - sprite->y)) : (c->scanline - sprite->y);
+        const uint8_t coarse_y = y >> 3;
+        const uint8_t fine_y = y & 7;
+
+        const _c2C02_tile *const tile = get_tile(
+            c, get_pattern_table_address(0, 0, (sprite->_8x16.tile << 1) | coarse_y, sprite->_8x16.bank));
+        *dest = tile->planes[reversed][fine_y][plane];
+    }
+    if (oam2_idx >= c->sprite_reg.n) {
+        *dest = 0;  // "Unused sprites are loaded with an all-transparent set of values."
+                    // https://www.nesdev.org/wiki/PPU_rendering
+    }
+}
+
+/** background palette index (0 if transparent) of the pixel `offset` dots after the current shifter position */
+inline static uint8_t _bg_pixel(const C2C02 *const c, const int offset) {
+    typeof(&c->bg_reg.shifters) const shifters = &c->bg_reg.shifters;
+    const uint16_t mux = 0x8000 >> (c->fine_x + offset);
+    const uint8_t p0 = (shifters->pattern.lo & mux) ? 1 : 0;
+    const uint8_t p1 = (shifters->pattern.hi & mux) ? 1 : 0;
+    const int val = ((p1 << 1) | p0);
+
+    const uint8_t b0 = (shifters->attr.lo & mux) ? 1 : 0;
+    const uint8_t b1 = (shifters->attr.hi & mux) ? 1 : 0;
+    const uint8_t palette_num = (b1 << 1) | b0;
+
+    return (val) ? ((palette_num << 2) | val) : 0;
+}
+
+/** lays out the line's sprites from their shifters, as they'd shift out over dots 1-256. Lower indices win, whatever
+ * their priority. https://www.nesdev.org/wiki/PPU_sprite_priority */
+static void _composite_sprites(C2C02 *const c) {
+    typeof(&c->sprite_reg) const reg = &c->sprite_reg;
+    memset(reg->line, 0, sizeof(reg->line));
+    for (int i = ARRAY_LEN(reg->shifters) - 1; i >= 0; i--) {
+        typeof(&reg->shifters[i]) const shifter = &reg->shifters[i];
+        const _c2C02_sprite_attr attrs = {.u8 = shifter->attr};
+        for (int offset = 0; (offset < 8) && ((shifter->x + offset) < 256); offset++) {
+            const int val = (((shifter->pattern_hi >> offset) & 1) << 1) | ((shifter->pattern_lo >> offset) & 1);
+            if (val) {
+                reg->line[shifter->x + offset] = (_c2C02_sprite_pixel){
+                    .val = val,
+                    .palette = attrs.palette,
+                    .priority = attrs.priority,
+                    .sprite0 = (i == 0) && reg->sprite0_present,
+                };
+            }
+        }
+    }
+}
+
+/** puts the line's sprite pixel at column x over background palette index `palette_idx` */
+inline static uint8_t _mix_sprite(C2C02 *const c, const int x, uint8_t palette_idx) {
+    const _c2C02_sprite_pixel px = c->sprite_reg.line[x];
+    if (!px.val || (!c->mask.sprites_left && (x < 8))) {
+        return palette_idx;
     }
+    // non-transparent sprite 0 pixel on a non-transparent background pixel, except at x=255
+    // https://www.nesdev.org/wiki/PPU_OAM#Sprite_zero_hits
+    if (px.sprite0 && palette_idx && (x != 255)) {
+        c->status.sprite_0_hit = 1;  // Todo - technically sprite_0_hit only happens dot >=2
+    }
+    if ((palette_idx == 0) || (px.priority == 0)) {
+        palette_idx = ((px.palette + 4) << 2) | px.val;
+    }
+    return palette_idx;
+}
 
+/** skip (0,0) on bg-enabled + odd-frame */
+inline static bool _skips_dot(const C2C02 *const c) {
+    return (c->scanline == 0) && (c->dot == 0) && c->mask.show_background && (c->frames & 1);
+}
+
+/** the background fetches, v updates and sprite evaluation of the current dot, which only happen with rendering on */
+static void _fetch_dot(C2C02 *const c) {
     if ((c->dot > 0 && c->dot <= 256) || (c->dot > 320 && c->dot <= 336)) {
-        c->bg_reg.shifters.attr.hi <<= 1;
-        c->bg_reg.shifters.attr.lo <<= 1;
-        c->bg_reg.shifters.pattern.hi <<= 1;
-        c->bg_reg.shifters.pattern.lo <<= 1;
+        _shift_bg(c);
 
         switch (c->dot & 7) {
             case 1: {               // NT
                 _load_shifters(c);  // shifters reloaded @ ticks 9, 17, 25... missing 257, but doesn't matter
-                c->bg_reg.next.nt = bus_read(c, 0x2000 | (c->vram_address._u16 & 0xFFF));
+                _fetch_nt(c);
                 break;
             }
             case 3: {  // AT
-                const uint8_t attr_byte =
-                    bus_read(c, get_attribute_table_address(0x2000 | (c->vram_address._u16 & 0xFFF)));
-
-                c->bg_reg.next.attr = get_palette_num(attr_byte, c->vram_address.coarse_x, c->vram_address.coarse_y);
+                _fetch_at(c);
                 break;
             }
             case 5: {  // BG lsb
-                c->bg_reg.next.pattern.lo =
-                    bus_read(c, get_pattern_table_address(c->vram_address.fine_y, 0, c->bg_reg.next.nt,
-                                                          c->ctrl.background_pattern_table));
+                _fetch_pattern(c, 0);
                 break;
             }
             case 7: {  // BG msb,  inc hori_v, draw last 8, load shifters
-                c->bg_reg.next.pattern.hi =
-                    bus_read(c, get_pattern_table_address(c->vram_address.fine_y, 1, c->bg_reg.next.nt,
-                                                          c->ctrl.background_pattern_table));
+                _fetch_pattern(c, 1);
                 break;
             }
             case 0: {
@@ -416,18 +598,11 @@ static void _render_scanlines(C2C02 *const c) {
         // Both of the bytes fetched here are the same nametable byte that will be fetched at the beginning of the next
         // scanline (tile 3, in other words). At least one mapper -- MMC5 -- is known to use this string of three
         // consecutive nametable fetches to clock a scanline counter.  https://www.nesdev.org/wiki/PPU_rendering
-        c->bg_reg.next.nt = bus_read(c, 0x2000 | (c->vram_address._u16 & 0xFFF));  // unused NT fetches
+        _fetch_nt(c);  // unused NT fetches
     }
 
-    if (c->scanline == -1) {
-        if (c->dot == 0) {
-            c->status.vblank = 0;
-            c->status.sprite_0_hit = 0;
-            c->status.sprite_overflow = 0;
-        }
-        if ((280 <= c->dot) && (c->dot <= 304)) {
-            _transfer_vert_v(c);
-        }
+    if ((c->scanline == -1) && (280 <= c->dot) && (c->dot <= 304)) {
+        _transfer_vert_v(c);
     }
 
     //// sprite eval - https://www.nesdev.org/wiki/PPU_sprite_evaluation
@@ -435,120 +610,276 @@ static void _render_scanlines(C2C02 *const c) {
         // Todo - byte-by-byte
         memset(c->oam2.sprites, 0xFF, sizeof(c->oam2.sprites));
     } else if (c->dot == 256) {
-        // Todo - load sprites into secondary OAM piecewise
-        c->sprite_reg.n = 0;
-        c->sprite_reg.sprite0_present = false;
-        for (size_t i = 0; i < ARRAY_LEN(c->oam.sprites); i++) {
-            const _c2C02_sprite *const sprite = &c->oam.sprites[i];
-            const int height = c->ctrl.sprite_size ? 16 : 8;
-            if ((c->scanline >= sprite->y) && (c->scanline < (sprite->y + height))) {
-                if (i == 0) {
-                    c->sprite_reg.sprite0_present = true;
-                }
-                c->oam2.sprites[c->sprite_reg.n++] = *sprite;
-                if (c->sprite_reg.n >= 8) {
-                    break;  // Todo - buggy sprite overflow...
-                }
-            }
-        }
+        _eval_sprites(c);
     } else if ((c->dot >= 257) && (c->dot <= 320)) {
         if (((c->dot & 7) == 6) || ((c->dot & 7) == 0)) {
-            const uint8_t oam2_idx = (c->dot - 257) >> 3;
-            const _c2C02_sprite *const sprite = &c->oam2.sprites[oam2_idx];
-            typeof(&c->sprite_reg.shifters[oam2_idx]) const shifter = &c->sprite_reg.shifters[oam2_idx];
-
-            const uint8_t plane = ((c->dot & 7) == 0) ? 1 : 0;
-            uint8_t *const dest = (plane) ? &shifter->pattern_hi : &shifter->pattern_lo;
-
-            shifter->attr = sprite->attributes.u8;
-            shifter->x = sprite->x;
-
-            if (c->ctrl.sprite_size == 0) {
-                const uint8_t fine_y =
-                    sprite->attributes.flip_vertical ? (7 - (c->scanline - sprite->y)) : (c->scanline - sprite->y);
-                *dest =
-                    bus_read(c, get_pattern_table_address(fine_y, plane, sprite->tile, c->ctrl.sprite_pattern_table));
-            } else {  // 8x16 sprites
-                const uint8_t y =
-                    sprite->attributes.flip_vertical ? (15 - (c->scanline - sprite->y)) : (c->scanline - sprite->y);
-                const uint8_t coarse_y = y >> 3;
-                const uint8_t fine_y = y & 7;
-
-                *dest = bus_read(c, get_pattern_table_address(fine_y, plane, (sprite->_8x16.tile << 1) | coarse_y,
-                                                              sprite->_8x16.bank));
-            }
-
-            if (!sprite->attributes.flip_horizontal) {
-                *dest = bit_reverse(*dest);
-            }
-            if (oam2_idx >= c->sprite_reg.n) {
-                *dest = 0;  // "Unused sprites are loaded with an all-transparent set of values."
-                            // https://www.nesdev.org/wiki/PPU_rendering
-            }
+            _fetch_sprite(c, (c->dot - 257) >> 3, ((c->dot & 7) == 0) ? 1 : 0);
         }
     }
+}
 
-    if ((c->dot >= 1) && (c->dot <= 256) && (c->scanline >= 0)) {
-        int palette_idx = 0;
+static void _render_scanlines(C2C02 *const c) {
+    if (_skips_dot(c)) {
+        c->dot++;
+    }
 
-        if (c->mask.show_background) {
-            typeof(&c->bg_reg.shifters) const shifters = &c->bg_reg.shifters;
-            const uint16_t mux = 0x8000 >> c->fine_x;
-            const uint8_t p0 = (shifters->pattern.lo & mux) ? 1 : 0;
-            const uint8_t p1 = (shifters->pattern.hi & mux) ? 1 : 0;
-            const int val = ((p1 << 1) | p0);
+    if ((c->scanline == -1) && (c->dot == 0)) {
+        c->status.vblank = 0;
+        c->status.sprite_0_hit = 0;
+        c->status.sprite_overflow = 0;
+    }
+    if (c->mask.show_background || c->mask.show_sprites) {
+        _fetch_dot(c);
+    }
 
-            const uint8_t b0 = (shifters->attr.lo & mux) ? 1 : 0;
-            const uint8_t b1 = (shifters->attr.hi & mux) ? 1 : 0;
-            const uint8_t palette_num = (b1 << 1) | b0;
+    if ((c->dot >= 1) && (c->dot <= 256) && (c->scanline >= 0)) {
+        const int x = c->dot - 1;
+        uint8_t palette_idx = 0;
 
-            if (c->mask.background_left || (c->dot > 8)) {
-                palette_idx = (val) ? ((palette_num << 2) | val) : 0;
-            }
+        if (c->mask.show_background && (c->mask.background_left || (x >= 8))) {
+            palette_idx = _bg_pixel(c, 0);
         }
 
+        if (x == 0) {
+            _composite_sprites(c);
+        }
         if (c->mask.show_sprites) {
-            // for each sprite on this scanline
-            for (size_t i = 0; i < ARRAY_LEN(c->sprite_reg.shifters); i++) {
-                typeof(&c->sprite_reg.shifters[i]) const shifter = &c->sprite_reg.shifters[i];
-                if (shifter->x != 0) {  // inactive
-                    continue;
-                }
-                const _c2C02_sprite_attr attrs = {.u8 = shifter->attr};
-                const uint8_t p0 = shifter->pattern_lo & 1;
-                const uint8_t p1 = shifter->pattern_hi & 1;
-                const int val = ((p1 << 1) | p0);
-                if ((i == 0) && val && palette_idx && c->sprite_reg.sprite0_present) {
-                    // non-transparent sprite px on non-transparent bg pix for sprite0
-                    c->status.sprite_0_hit = 1;  // Todo - technically sprite_0_hit only happens dot >=2
-                }
-                if (val) {
-                    if (c->mask.sprites_left || (c->dot > 8)) {
-                        if ((palette_idx == 0) || (attrs.priority == 0)) {
-                            palette_idx = ((attrs.palette + 4) << 2) | val;
-                        }
-                    }
-                    break;  // https://www.nesdev.org/wiki/PPU_sprite_priority
-                }
-            }
+            palette_idx = _mix_sprite(c, x, palette_idx);
+        }
 
-            // update sprite shifters
-            for (size_t i = 0; i < ARRAY_LEN(c->sprite_reg.shifters); i++) {
-                if (c->sprite_reg.shifters[i].x) {
-                    c->sprite_reg.shifters[i].x--;
-                } else {
-                    c->sprite_reg.shifters[i].pattern_lo >>= 1;
-                    c->sprite_reg.shifters[i].pattern_hi >>= 1;
-                }
+        if (!c->skip_video) {
+            draw_pixel(c, x, c->scanline, bus_read(c, 0x3F00 | palette_idx));
+        }
+    }
+}
+
+/** fetches the tile for the next 8 dots: the work the dot renderer spreads over dots 8n+1 to 8n+7 */
+inline static void _fetch_tile(C2C02 *const c) {
+    _shift_bg(c);
+    _load_shifters(c);
+    _fetch_nt(c);
+    _fetch_at(c);
+    _fetch_pattern(c, 0);
+    _fetch_pattern(c, 1);
+}
+
+/** the rest of dot 8n+1 through 8n+8, after the tile fetch */
+inline static void _finish_tile(C2C02 *const c) {
+    for (int i = 0; i < 7; i++) {
+        _shift_bg(c);
+    }
+    _inc_hori_v(c);
+}
+
+typedef struct {
+    const uint8_t *pixels;
+    uint8_t palette;
+} _line_tile;
+
+/** what _compose_line() would do to the sprite 0 hit flag, from sprite 0's pixels alone */
+static void _sprite_0_hit(C2C02 *const c, const _line_tile tiles[34]) {
+    if (!c->mask.show_background || !c->mask.show_sprites || !c->sprite_reg.sprite0_present ||
+        c->status.sprite_0_hit) {
+        return;
+    }
+    const int start = c->sprite_reg.shifters[0].x;
+    for (int x = start; (x < (start + 8)) && (x < 255); x++) {
+        const int tile_x = x + c->fine_x;
+        const bool visible = (c->mask.background_left && c->mask.sprites_left) || (x >= 8);
+        if (visible && c->sprite_reg.line[x].sprite0 && tiles[tile_x >> 3].pixels[tile_x & 7]) {
+            c->status.sprite_0_hit = 1;
+            return;
+        }
+    }
+}
+
+/** palette indices of a tile row, all 8 pixels at once: the colors, plus the palette where they aren't transparent */
+inline static uint64_t _tile_row_indices(const _line_tile *const tile) {
+    static const uint64_t LSBS = 0x0101010101010101ull;
+    uint64_t colors;
+    memcpy(&colors, tile->pixels, sizeof(colors));
+    const uint64_t opaque = ((colors | (colors >> 1)) & LSBS) * 0xFF;  // 0xFF bytes where the color isn't 0
+    return colors | ((tile->palette * (LSBS << 2)) & opaque);
+}
+
+/** background and sprites of the line the tiles hold, into the framebuffer */
+static void _compose_line(C2C02 *const c, const _line_tile tiles[34]) {
+    // the tiles' palette indices back to back, the line starting fine_x pixels in
+    uint8_t tile_line[34 * 8];
+    uint8_t *const line = &tile_line[c->fine_x];
+    if (c->mask.show_background) {
+        for (int i = 0; i < 34; i++) {
+            const uint64_t indices = _tile_row_indices(&tiles[i]);
+            memcpy(&tile_line[i * 8], &indices, sizeof(indices));
+        }
+        if (!c->mask.background_left) {
+            memset(line, 0, 8);
+        }
+    } else {
+        memset(line, 0, 256);
+    }
+
+    if (c->mask.show_sprites) {
+        for (int x = 0; x < 256; x++) {
+            line[x] = _mix_sprite(c, x, line[x]);
+        }
+    }
+
+    if (c->framebuffer) {
+        uint16_t pixels[0x20];  // per palette index, under the current mask
+        for (size_t i = 0; i < ARRAY_LEN(pixels); i++) {
+            pixels[i] = get_pixel(c, c->palette_ram[mirror_palette_ram_addr(i)]);
+        }
+        uint16_t *const row = &c->framebuffer[c->scanline * C2C02_WIDTH];
+        for (int x = 0; x < 256; x++) {
+            row[x] = pixels[line[x]];
+        }
+    }
+}
+
+/** Renders a whole visible scanline, dot 0 through 340, in one pass. Gives the same result as the dot renderer as long
+ * as no register is touched mid-line, which holds whenever c2C02_run is asked to cover the whole line: the bus syncs
+ * the ppu before every register access. */
+static void _render_scanline(C2C02 *const c) {
+    // the line shows 33 tiles, offset by fine_x. The first two were fetched at the end of the previous line: one is
+    // in the upper shifter bits, the other still in bg_reg.next. The rest are fetched here, plus one more that's
+    // never seen. The shifters themselves aren't needed until the prefetch for the next line
+    _line_tile tiles[34];
+    uint8_t first_pixels[2][8];
+    _composite_sprites(c);
+    typeof(&c->bg_reg.shifters) const shifters = &c->bg_reg.shifters;
+    decode_row(shifters->pattern.lo >> 7, shifters->pattern.hi >> 7, first_pixels[0]);
+    tiles[0].pixels = first_pixels[0];
+    tiles[0].palette = (((shifters->attr.hi >> 14) & 1) << 1) | ((shifters->attr.lo >> 14) & 1);
+    decode_row(c->bg_reg.next.pattern.lo, c->bg_reg.next.pattern.hi, first_pixels[1]);
+    tiles[1].pixels = first_pixels[1];
+    tiles[1].palette = c->bg_reg.next.attr;
+
+    for (int i = 2; i < 34; i++) {  // dots 1-256
+        _fetch_nt(c);
+        _fetch_at(c);
+        const _c2C02_tile *const tile = _get_bg_tile(c);
+        c->bg_reg.next.pattern.lo = tile->planes[0][c->vram_address.fine_y][0];
+        c->bg_reg.next.pattern.hi = tile->planes[0][c->vram_address.fine_y][1];
+        tiles[i].pixels = tile->pixels[c->vram_address.fine_y];
+        tiles[i].palette = c->bg_reg.next.attr;
+        _inc_hori_v(c);
+    }
+    _inc_vert_v(c);
+
+    if (c->skip_video) {
+        _sprite_0_hit(c, tiles);
+    } else {
+        _compose_line(c, tiles);
+    }
+
+    // dots 257-340: sprites for the next line, then its first two tiles
+    memset(c->oam2.sprites, 0xFF, sizeof(c->oam2.sprites));
+    _eval_sprites(c);
+    _transfer_hori_v(c);
+    for (uint8_t i = 0; i < ARRAY_LEN(c->sprite_reg.shifters); i++) {
+        bus_read(c, 0x2000 | (c->vram_address._u16 & 0xFFF));  // garbage NT and AT fetches
+        bus_read(c, get_attribute_table_address(0x2000 | (c->vram_address._u16 & 0xFFF)));
+        _fetch_sprite(c, i, 0);
+        _fetch_sprite(c, i, 1);
+    }
+    // the prefetch shifts out everything the shifters held before it, so start it from a clean slate
+    memset(shifters, 0, sizeof(*shifters));
+    for (int tile = 0; tile < 2; tile++) {
+        _fetch_tile(c);
+        _finish_tile(c);
+    }
+    _fetch_nt(c);
+    _fetch_nt(c);
+}
+
+/** Dots 8n+1 through 8n+8 of a rendering scanline in one go, the same as stepping them one by one: one tile's fetches,
+ * and its 8 pixels from the shifters. For spans that don't cover a whole line, i.e. the bus synced the ppu mid-line */
+static void _render_tile_dots(C2C02 *const c) {
+    _fetch_tile(c);  // dot 8n+1's shift and shifter reload come before its pixel
+    if ((c->dot <= 256) && (c->scanline >= 0)) {
+        if (c->dot == 1) {
+            _composite_sprites(c);
+        }
+        for (int i = 0; i < 8; i++) {
+            const int x = c->dot - 1 + i;
+            uint8_t palette_idx = 0;
+            if (c->mask.show_background && (c->mask.background_left || (x >= 8))) {
+                palette_idx = _bg_pixel(c, i);
+            }
+            if (c->mask.show_sprites) {
+                palette_idx = _mix_sprite(c, x, palette_idx);
+            }
+            if (!c->skip_video) {
+                draw_pixel(c, x, c->scanline, bus_read(c, 0x3F00 | palette_idx));
             }
         }
+    }
+    _finish_tile(c);
+    if (c->dot == 57) {  // dot 64
+        memset(c->oam2.sprites, 0xFF, sizeof(c->oam2.sprites));
+    } else if (c->dot == 249) {  // dot 256
+        _inc_vert_v(c);
+        _eval_sprites(c);
+    }
+    c->dot += 8;
+    c->clocks += 8;
+}
 
-        const int cc = bus_read(c, 0x3F00 | palette_idx);
-        draw_pixel(c, c->dot - 1, c->scanline, cc);
+/** dots 257-320 of a rendering scanline in one go: garbage nametable fetches and the next line's sprites */
+static void _render_sprite_fetch_dots(C2C02 *const c) {
+    _transfer_hori_v(c);
+    for (uint8_t i = 0; i < ARRAY_LEN(c->sprite_reg.shifters); i++) {
+        if ((c->scanline == -1) && (i == 3)) {
+            _transfer_vert_v(c);  // dots 280-304, between the fetches for sprites 2 and 3
+        }
+        bus_read(c, 0x2000 | (c->vram_address._u16 & 0xFFF));
+        bus_read(c, get_attribute_table_address(0x2000 | (c->vram_address._u16 & 0xFFF)));
+        _fetch_sprite(c, i, 0);
+        _fetch_sprite(c, i, 1);
     }
+    c->dot += 64;
+    c->clocks += 64;
 }
 
-void c2C02_cycle(C2C02 *const c) {
+/** renders the longest block of dots from the current one that fits in `dots` and has a batched form. Returns the
+ * dots rendered, 0 to step a single dot instead */
+static int _render_dots(C2C02 *const c, const uint64_t dots) {
+    if ((c->scanline >= 240) || ((c->dot & 7) != 1)) {
+        return 0;
+    }
+    if ((dots >= 8) && ((c->dot <= 249) || (c->dot == 321) || (c->dot == 329))) {
+        _render_tile_dots(c);
+        return 8;
+    }
+    if ((dots >= 64) && (c->dot == 257)) {
+        _render_sprite_fetch_dots(c);
+        return 64;
+    }
+    return 0;
+}
+
+inline static void _next_scanline(C2C02 *const c) {
+    c->dot = 0;
+    c->scanline++;
+    if (c->scanline == 240) {
+        if (c->frame_done.callback) {
+            c->frame_done.callback(c->frame_done.ctx);
+        }
+    } else if (c->scanline >= (SCANLINES_PER_FRAME - 1)) {
+        c->scanline = -1;
+        c->frames++;
+        if ((c->frames & 7) == 0) {
+            // bits that were refreshed in oldest cycle and not any more recent ones decay to 0
+            const uint8_t decayed =
+                c->open_bus.fresh[4] & (~(c->open_bus.fresh[2] | c->open_bus.fresh[1] | c->open_bus.fresh[0]));
+            c->open_bus.val &= ~decayed;
+            c->open_bus.shift_out <<= 8;
+        }
+    }
+}
+
+inline static void _cycle(C2C02 *const c) {
     // https://www.nesdev.org/w/images/default/4/4f/Ppu.svg
     if (c->scanline < 240) {
         _render_scanlines(c);
@@ -559,19 +890,191 @@ void c2C02_cycle(C2C02 *const c) {
     // progress the scan position
     c->clocks++;
     c->dot++;
-    if (c->dot > 340) {
-        c->dot = 0;
-        c->scanline++;
-        if (c->scanline > 260) {
-            c->scanline = -1;
-            c->frames++;
-            if ((c->frames & 7) == 0) {
-                // bits that were refreshed in oldest cycle and not any more recent ones decay to 0
-                const uint8_t decayed =
-                    c->open_bus.fresh[4] & (~(c->open_bus.fresh[2] | c->open_bus.fresh[1] | c->open_bus.fresh[0]));
-                c->open_bus.val &= ~decayed;
-                c->open_bus.shift_out <<= 8;
+    if (c->dot >= DOTS_PER_SCANLINE) {
+        _next_scanline(c);
+    }
+}
+
+void c2C02_cycle(C2C02 *const c) {
+    _cycle(c);
+}
+
+/** dots from the current one on, to the end of its scanline at most, in which nothing but drawing the backdrop
+ * happens. 0 if the current dot has work to do */
+inline static int _idle_dots(const C2C02 *const c) {
+    const int rest = DOTS_PER_SCANLINE - c->dot;
+    if (c->scanline >= 240) {  // idle except the vblank flag and nmi at 241, dots 0-2
+        return ((c->scanline == 241) && (c->dot <= 2)) ? 0 : rest;
+    }
+    if (c->mask.show_background || c->mask.show_sprites) {
+        return 0;
+    }
+    // rendering off: no fetches, no v updates, no sprite evaluation. Just the flags cleared on the pre-render line
+    return ((c->scanline == -1) && (c->dot == 0)) ? 0 : rest;
+}
+
+uint64_t c2C02_fast_forward(C2C02 *const c, const uint64_t clocks) {
+    const uint64_t start = c->clocks;
+    while (c->clocks < clocks) {
+        const int idle = _idle_dots(c);
+        if (idle == 0) {
+            break;
+        }
+        const int dots = ((clocks - c->clocks) < (uint64_t)idle) ? (int)(clocks - c->clocks) : idle;
+        if ((c->scanline >= 0) && (c->scanline < 240) && c->framebuffer && !c->skip_video) {
+            // the backdrop color, as the dot renderer draws it with rendering off
+            const uint16_t backdrop = get_pixel(c, c->palette_ram[0]);
+            const int end = (c->dot + dots < 257) ? (c->dot + dots) : 257;
+            uint16_t *const row = &c->framebuffer[c->scanline * C2C02_WIDTH];
+            for (int x = (c->dot > 0) ? (c->dot - 1) : 0; x < end - 1; x++) {
+                row[x] = backdrop;
             }
         }
+        c->clocks += dots;
+        c->dot += dots;
+        if (c->dot >= DOTS_PER_SCANLINE) {
+            _next_scanline(c);
+        }
+    }
+    return c->clocks - start;
+}
+
+void c2C02_run(C2C02 *const c, const uint64_t clocks) {
+    while (c->clocks < clocks) {
+        if (c2C02_fast_forward(c, clocks) > 0) {
+            continue;
+        }
+        if ((c->dot == 0) && (c->scanline >= 0) && (c->scanline < 240)) {
+            const uint64_t dots = DOTS_PER_SCANLINE - (_skips_dot(c) ? 1 : 0);
+            if ((clocks - c->clocks) >= dots) {  // nothing can touch the ppu mid-line, so render it in one go
+                _render_scanline(c);
+                c->clocks += dots;
+                _next_scanline(c);
+                continue;
+            }
+        }
+        if (_render_dots(c, clocks - c->clocks) == 0) {
+            _cycle(c);
+        }
+    }
+}
+
+// https://www.nesdev.org/wiki/NTSC_video#Color_Tint_Bits
+// each emphasis bit attenuates the other two channels. Emphasizing all three darkens everything
+#define EMPHASIS_ATTENUATION 0.816328
+
+void c2C02_palette_init(C2C02Palette *const palette, const C2C02PixelFormat format) {
+    palette->format = format;
+    for (size_t i = 0; i < ARRAY_LEN(palette->lut); i++) {
+        const uint8_t *const color = system_colors[i & C2C02_PIXEL_COLOR_MASK];
+        const uint8_t emphasis = i >> C2C02_PIXEL_EMPHASIS_SHIFT;  // bit 0 red, 1 green, 2 blue
+        uint8_t rgb[3];
+        for (int ch = 0; ch < 3; ch++) {
+            const bool attenuate = emphasis & ~(1 << ch);
+            rgb[ch] = attenuate ? (uint8_t)((color[ch] * EMPHASIS_ATTENUATION) + 0.5) : color[ch];
+        }
+
+        switch (format) {
+            case C2C02_RGBA8888:
+                palette->lut[i] = (rgb[0] << 24) | (rgb[1] << 16) | (rgb[2] << 8) | 0xFF;
+                break;
+            case C2C02_ABGR8888:
+                palette->lut[i] = 0xFF000000 | (rgb[2] << 16) | (rgb[1] << 8) | rgb[0];
+                break;
+            case C2C02_RGB565:
+                palette->lut[i] = ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+                break;
+        }
+    }
+#ifdef X86_DISPATCH
+    palette->avx2 = __builtin_cpu_supports("avx2");
+#else
+    palette->avx2 = false;
+#endif
+}
+
+#ifdef X86_DISPATCH
+/** 8 pixels at a time with gathers from the lut. Returns how many pixels were converted */
+__attribute__((target("avx2"))) static size_t palette_convert_avx2(const C2C02Palette *const palette,
+                                                                   const uint16_t *const pixels, void *const out,
+                                                                   const size_t n) {
+    const __m256i index_mask = _mm256_set1_epi32(ARRAY_LEN(palette->lut) - 1);
+    size_t i = 0;
+    for (; (i + 8) <= n; i += 8) {
+        const __m256i index =
+            _mm256_and_si256(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&pixels[i])), index_mask);
+        const __m256i color = _mm256_i32gather_epi32((const int *)palette->lut, index, 4);
+        if (palette->format == C2C02_RGB565) {
+            const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(color), _mm256_extracti128_si256(color, 1));
+            _mm_storeu_si128((__m128i *)&((uint16_t *)out)[i], packed);
+        } else {
+            _mm256_storeu_si256((__m256i *)&((uint32_t *)out)[i], color);
+        }
+    }
+    return i;
+}
+#endif
+
+void c2C02_palette_convert(const C2C02Palette *const palette, const uint16_t *const pixels, void *const out,
+                           const size_t n) {
+    size_t i = 0;
+#ifdef X86_DISPATCH
+    if (palette->avx2) {
+        i = palette_convert_avx2(palette, pixels, out, n);
+    }
+#endif
+    const size_t index_mask = ARRAY_LEN(palette->lut) - 1;
+    if (palette->format == C2C02_RGB565) {
+        for (; i < n; i++) {
+            ((uint16_t *)out)[i] = palette->lut[pixels[i] & index_mask];
+        }
+    } else {
+        for (; i < n; i++) {
+            ((uint32_t *)out)[i] = palette->lut[pixels[i] & index_mask];
+        }
+    }
+}
+
+// position in the frame, counting from the pre-render scanline
+inline static int frame_index(const int scanline, const int dot) {
+    return ((scanline + 1) * DOTS_PER_SCANLINE) + dot;
+}
+
+uint64_t c2C02_clock_at(const C2C02 *const c, const int scanline, const int dot) {
+    static const int DOTS_PER_FRAME = SCANLINES_PER_FRAME * DOTS_PER_SCANLINE;
+    const int odd_frame_skip = frame_index(0, 0);  // (0,0) skipped on odd frames w/ bg enabled
+    const int from = frame_index(c->scanline, c->dot);
+    const int to = frame_index(scanline, dot);
+
+    uint64_t dots;
+    if (to >= from) {
+        dots = to - from + 1;
+        if ((c->frames & 1) && (from <= odd_frame_skip) && (odd_frame_skip <= to)) {
+            dots--;
+        }
+    } else {  // wraps into the next frame
+        dots = DOTS_PER_FRAME - from + to + 1;
+        if ((c->frames & 1) && (from <= odd_frame_skip)) {
+            dots--;
+        }
+        if (((c->frames + 1) & 1) && (odd_frame_skip <= to)) {
+            dots--;
+        }
+    }
+    return c->clocks + dots;
+}
+
+uint64_t c2C02_status_stable_until(const C2C02 *const c) {
+    const bool rendering = c->mask.show_background || c->mask.show_sprites;
+    const bool sprite_flags_open = !(c->status.sprite_0_hit && c->status.sprite_overflow);
+    if (c->status.vblank || (rendering && (c->scanline < 240) && sprite_flags_open)) {
+        return c->clocks;
+    }
+    if ((frame_index(c->scanline, c->dot) == 0) && (c->status.sprite_0_hit || c->status.sprite_overflow)) {
+        return c->clocks;  // about to clear them
     }
+    // vblank is set processing (241, 0) and everything clears at (-1, 0). A read the clock before (241, 0) already
+    // suppresses the flag and nmi
+    const bool before_vblank = frame_index(c->scanline, c->dot) <= frame_index(241, 0);
+    return (before_vblank ? c2C02_clock_at(c, 241, 0) : c2C02_clock_at(c, -1, 0)) - 1;
 }
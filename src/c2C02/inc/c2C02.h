@@ -1,13 +1,38 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#define C2C02_WIDTH 256
+#define C2C02_HEIGHT 240
+
+// framebuffer pixels: bits 0-5 system palette index (grayscale already applied), bits 6-8 PPUMASK color emphasis
+#define C2C02_PIXEL_COLOR_MASK 0x3F
+#define C2C02_PIXEL_EMPHASIS_SHIFT 6
+
+#define C2C02_BUS_PAGE_BITS 10  // 1KB
+#define C2C02_BUS_PAGE_SIZE (1 << C2C02_BUS_PAGE_BITS)
+
 typedef struct {
     uint8_t (*read)(void *bus_ctx, uint16_t addr);
     bool (*write)(void *bus_ctx, uint16_t addr, uint8_t val);
 } C2C02BusInterface;
 
+typedef enum {
+    C2C02_RGBA8888,  // 0xRRGGBBAA
+    C2C02_ABGR8888,  // 0xAABBGGRR, i.e. R,G,B,A bytes in memory on little endian
+    C2C02_RGB565,
+} C2C02PixelFormat;
+
+typedef struct {
+    C2C02PixelFormat format;
+
+    // private
+    uint32_t lut[1 << 9];  // framebuffer pixel (emphasis + color) to output pixel
+    bool avx2;
+} C2C02Palette;
+
 typedef union __attribute__((__packed__)) {
     uint8_t u8;
     struct __attribute__((__packed__)) {
@@ -36,6 +61,24 @@ typedef struct __attribute__((__packed__)) {
     uint8_t x;  // X position of left side of sprite.
 } _c2C02_sprite;
 
+// one predecoded pattern table tile. https://www.nesdev.org/wiki/PPU_pattern_tables
+typedef struct {
+    uint8_t planes[2][8][2];  // [flipped][row][plane] pattern bytes, flipped ones bit reversed
+    uint8_t pixels[8][8];     // [row][x] 2b color, leftmost first
+} _c2C02_tile;
+
+// one pixel of a scanline's sprites, composited before the line is drawn
+typedef union __attribute__((__packed__)) {
+    uint8_t u8;
+    struct __attribute__((__packed__)) {
+        uint8_t val : 2;       // 2b color, 0 where no sprite shows
+        uint8_t palette : 2;   // Palette (4 to 7) of sprite
+        uint8_t priority : 1;  // Priority (0: in front of background; 1: behind background)
+        uint8_t sprite0 : 1;   // drawn by sprite 0, a hit if it meets the background
+        uint8_t : 2;
+    };
+} _c2C02_sprite_pixel;
+
 typedef struct C2C02 {
     struct {
         void (*callback)(void *ctx);
@@ -47,8 +90,20 @@ typedef struct C2C02 {
     const C2C02BusInterface *bus;
     void *bus_ctx;
 
-    void (*draw_pixel)(void *draw_ctx, int x, int y, uint8_t r, uint8_t g, uint8_t b);
-    void *draw_ctx;
+    // optional view of the bus $0000-$3FFF as pages of host memory. Reads from non-NULL pages skip the bus interface
+    const uint8_t *const *bus_pages;
+
+    // C2C02_WIDTH x C2C02_HEIGHT pixels, row by row. Caller provided, ideally 32B aligned. Nothing drawn if NULL
+    uint16_t *framebuffer;
+
+    // frameskip: while set nothing is drawn, and the pixel work is skipped. Fetches, sprite 0 hits and the flag timing
+    // stay the same, so the cpu sees no difference. Meant to change between frames, e.g. to draw 1 frame in every n
+    bool skip_video;
+
+    struct {
+        void (*callback)(void *ctx);
+        void *ctx;
+    } frame_done;  // called once the last visible scanline is in the framebuffer
 
     // private
     int dot;
@@ -64,8 +119,8 @@ typedef struct C2C02 {
         uint8_t val;  // current open-bus value
     } open_bus;
 
-    int clocks;
-    int last_status_read_clocks;
+    uint64_t clocks;  // total dots processed
+    uint64_t last_status_read_clocks;
 
     bool address_latch;
     uint8_t data_read_buffer;
@@ -109,7 +164,7 @@ typedef struct C2C02 {
             uint8_t sprites_left : 1;
             uint8_t show_background : 1;
             uint8_t show_sprites : 1;
-            uint8_t emphasize_red : 1;  // Todo color emphasis
+            uint8_t emphasize_red : 1;  // applied by c2C02_palette_convert(), see C2C02_PIXEL_EMPHASIS_SHIFT
             uint8_t emphasize_green : 1;
             uint8_t emphasize_blue : 1;
         };
@@ -164,6 +219,8 @@ typedef struct C2C02 {
             uint8_t pattern_lo;
             uint8_t pattern_hi;
         } shifters[8];
+
+        _c2C02_sprite_pixel line[256];  // the shifters composited at dot 1, lowest index on top
     } sprite_reg;
 
     struct {
@@ -186,9 +243,43 @@ typedef struct C2C02 {
     } bg_reg;
 
     uint32_t frames;
+
+    // tiles decoded on first fetch, keyed by pattern table address. The owner of the chr memory has to call
+    // c2C02_invalidate_chr when it bank switches. Writes through the ppu invalidate their tile automatically
+    struct {
+        _c2C02_tile tiles[0x2000 / 16];
+        uint64_t valid[(0x2000 / 16) / 64];  // bitset
+    } chr_cache;
 } C2C02;
 
 void c2C02_cycle(C2C02 *);
 
+/** run dots until c->clocks reaches the given clock */
+void c2C02_run(C2C02 *, uint64_t clocks);
+
+/** jumps towards the given clock over dots that have nothing to do: scanlines 240-260 outside of setting vblank and
+ * the nmi, and whole scanlines while rendering is off. Stops at the first dot that does something, such as vblank
+ * being set, the nmi edge or the pre-render line clearing the flags. Returns the dots jumped, 0 if the current dot
+ * isn't idle. c2C02_run() already does this, register reads and writes see the same state either way */
+uint64_t c2C02_fast_forward(C2C02 *, uint64_t clocks);
+
+/** clock value at which the given scanline/dot will have been processed. Assumes the odd-frame dot skip happens
+ * whenever it still could, so the result may be 1 early but never late - re-check the position once there. */
+uint64_t c2C02_clock_at(const C2C02 *, int scanline, int dot);
+
+/** clock before which reads of PPUSTATUS from now on all return the same, with no side effects beyond the first
+ * one's: until vblank is set or cleared. c->clocks while the next read would clear vblank, or rendering could set the
+ * sprite flags */
+uint64_t c2C02_status_stable_until(const C2C02 *);
+
+/** drops all cached pattern table tiles, e.g. after a chr bank switch */
+void c2C02_invalidate_chr(C2C02 *);
+
+/** initializes a palette for converting framebuffer pixels to the given format, emphasis included */
+void c2C02_palette_init(C2C02Palette *, C2C02PixelFormat);
+
+/** converts n framebuffer pixels. out holds uint32_t pixels, or uint16_t for C2C02_RGB565 */
+void c2C02_palette_convert(const C2C02Palette *, const uint16_t *pixels, void *out, size_t n);
+
 uint8_t c2C02_read_reg(C2C02 *, uint8_t addr);
 void c2C02_write_reg(C2C02 *, uint8_t addr, uint8_t val);
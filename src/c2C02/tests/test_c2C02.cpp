@@ -38,6 +38,7 @@ TEST_GROUP(C2C02TestGroup) {
 
     TEST_SETUP() {
         c.bus = &bus;
+        c.bus_pages = NULL;
     }
 
     TEST_TEARDOWN() {
@@ -86,6 +87,24 @@ TEST(C2C02TestGroup, test_read_ppu_data) {
     ret = c2C02_read_reg(&c, 0x7);
 }
 
+TEST(C2C02TestGroup, test_read_ppu_data_bus_pages) {
+    static uint8_t nametable[C2C02_BUS_PAGE_SIZE];
+    const uint8_t *pages[0x4000 >> C2C02_BUS_PAGE_BITS] = {0};
+    pages[0x2400 >> C2C02_BUS_PAGE_BITS] = nametable;
+    nametable[0x21] = 0x66;
+    c.bus_pages = pages;
+    c.ctrl.vram_inc = 0;
+    c.vram_address.addr = 0x2421;
+
+    c2C02_read_reg(&c, 0x7);  // no bus call
+    CHECK_EQUAL(0x66, c.data_read_buffer);
+
+    c.vram_address.addr = 0x2821;
+    mock_bus::expect_read(0x2821, 0x77);  // unmapped page
+    c2C02_read_reg(&c, 0x7);
+    CHECK_EQUAL(0x77, c.data_read_buffer);
+}
+
 TEST(C2C02TestGroup, test_write_ppu_data_to_palette) {
     c.vram_address.addr = 0x3F01;
     c2C02_write_reg(&c, 0x07, 0x12);
@@ -131,3 +150,288 @@ TEST(C2C02TestGroup, test_read_ppu_data_palette) {
     // c.vram_address.addr = 0x3F0;
     // CHECK_EQUAL(c2C02_read_reg(&c, 0x07), 0);
 }
+
+static uint8_t vmem[0x4000];
+
+static uint8_t vmem_read(void *, uint16_t addr) {
+    return vmem[addr & 0x3FFF];
+}
+
+static bool vmem_write(void *, uint16_t addr, uint8_t val) {
+    vmem[addr & 0x3FFF] = val;
+    return true;
+}
+
+static const C2C02BusInterface vmem_bus = {.read = vmem_read, .write = vmem_write};
+
+/** random vram, oam, palette, scroll and shifters mid-frame, rendering on */
+static void random_scene(C2C02 *const p) {
+    srand(1);
+    for (size_t i = 0; i < sizeof(vmem); i++) {
+        vmem[i] = rand();
+    }
+    memset(p, 0, sizeof(*p));
+    p->bus = &vmem_bus;
+    p->mask.u8 = 0x3E;  // bg + sprites, incl. left column, red emphasis
+    p->ctrl.u8 = 0x18;
+    p->vram_address._u16 = rand();
+    p->temp_vram_address._u16 = rand();
+    p->fine_x = 5;
+    for (size_t i = 0; i < sizeof(p->palette_ram); i++) {
+        p->palette_ram[i] = rand() & 0x3F;
+    }
+    for (size_t i = 0; i < 64; i++) {
+        p->oam.sprites[i].y = 4 + (rand() & 7);
+        p->oam.sprites[i].tile = rand();
+        p->oam.sprites[i].attributes.u8 = rand();
+        p->oam.sprites[i].x = rand();
+    }
+    p->sprite_reg.n = 8;
+    p->sprite_reg.sprite0_present = true;
+    for (size_t i = 0; i < 8; i++) {
+        p->sprite_reg.shifters[i] = {(uint8_t)rand(), (uint8_t)(i * 30), (uint8_t)rand(), (uint8_t)rand()};
+    }
+    p->bg_reg.shifters.pattern.lo = rand() & 0x7F80;  // first tile, as left by the prefetch
+    p->bg_reg.shifters.pattern.hi = rand() & 0x7F80;
+    p->bg_reg.shifters.attr.hi = 0x7F80;
+    p->bg_reg.next.pattern.lo = rand();
+    p->bg_reg.next.pattern.hi = rand();
+    p->bg_reg.next.attr = 1;
+}
+
+TEST(C2C02TestGroup, test_scanline_matches_dot_renderer) {
+    static uint16_t fb_line[C2C02_WIDTH * C2C02_HEIGHT], fb_dot[C2C02_WIDTH * C2C02_HEIGHT];
+    C2C02 line, dot;
+
+    random_scene(&line);
+    for (int scanline = 8; scanline < 12; scanline++) {
+        line.scanline = scanline;
+        memcpy(&dot, &line, sizeof(line));
+        line.framebuffer = fb_line;
+        dot.framebuffer = fb_dot;
+
+        c2C02_run(&line, line.clocks + 341);
+        for (int i = 0; i < 341; i++) {
+            c2C02_cycle(&dot);
+        }
+        dot.framebuffer = fb_line;
+        MEMCMP_EQUAL(&dot, &line, sizeof(line));
+        MEMCMP_EQUAL(fb_dot, fb_line, sizeof(fb_line));
+    }
+    CHECK(line.status.sprite_0_hit);
+}
+
+static void count_frames(void *ctx) {
+    (*(int *)ctx)++;
+}
+
+TEST(C2C02TestGroup, test_framebuffer) {
+    static uint16_t fb[C2C02_WIDTH * C2C02_HEIGHT];
+    int frames_done = 0;
+
+    memset(&c, 0, sizeof(c));
+    memset(vmem, 0, sizeof(vmem));
+    c.bus = &vmem_bus;
+    c.framebuffer = fb;
+    c.frame_done.callback = count_frames;
+    c.frame_done.ctx = &frames_done;
+    c.palette_ram[0] = 0x2A;
+    c.mask.u8 = 0xA0;  // rendering off, blue + red emphasis
+
+    c2C02_run(&c, 341 * 241);
+    CHECK_EQUAL(1, frames_done);
+    CHECK_EQUAL(0x2A | (0x5 << C2C02_PIXEL_EMPHASIS_SHIFT), fb[0]);
+    CHECK_EQUAL(fb[0], fb[(C2C02_WIDTH * C2C02_HEIGHT) - 1]);
+}
+
+TEST(C2C02TestGroup, test_palette_convert) {
+    static C2C02Palette palette;
+    uint16_t pixels[19];
+    uint32_t rgba[19];
+    uint16_t rgb565[19];
+
+    for (size_t i = 0; i < 19; i++) {
+        pixels[i] = 0x2A;  // 0x2B, 0xF0, 0x35
+    }
+    pixels[17] = 0x2A | (0x1 << C2C02_PIXEL_EMPHASIS_SHIFT);  // red emphasis
+    pixels[18] = 0x2A | (0x7 << C2C02_PIXEL_EMPHASIS_SHIFT);
+
+    c2C02_palette_init(&palette, C2C02_ABGR8888);
+    c2C02_palette_convert(&palette, pixels, rgba, 19);
+    CHECK_EQUAL(0xFF35F02B, rgba[0]);
+    CHECK_EQUAL(0xFF35F02B, rgba[16]);  // past the vectorized part
+    CHECK_EQUAL(0xFF2BC42B, rgba[17]);  // green, blue attenuated
+    CHECK_EQUAL(0xFF2BC423, rgba[18]);  // all attenuated
+
+    c2C02_palette_init(&palette, C2C02_RGBA8888);
+    c2C02_palette_convert(&palette, pixels, rgba, 19);
+    CHECK_EQUAL(0x2BF035FF, rgba[9]);
+
+    c2C02_palette_init(&palette, C2C02_RGB565);
+    c2C02_palette_convert(&palette, pixels, rgb565, 19);
+    CHECK_EQUAL((0x2B >> 3) << 11 | (0xF0 >> 2) << 5 | (0x35 >> 3), rgb565[0]);
+    CHECK_EQUAL(rgb565[0], rgb565[16]);
+
+    palette.avx2 = false;  // scalar fallback agrees
+    uint16_t scalar[19];
+    c2C02_palette_convert(&palette, pixels, scalar, 19);
+    MEMCMP_EQUAL(rgb565, scalar, sizeof(scalar));
+}
+
+TEST(C2C02TestGroup, test_chr_cache_invalidation) {
+    memset(&c, 0, sizeof(c));
+    c.bus = &vmem_bus;
+    memset(c.chr_cache.valid, 0xFF, sizeof(c.chr_cache.valid));
+
+    c.vram_address.addr = 0x1013;  // tile 0x101
+    c2C02_write_reg(&c, 0x7, 0xAA);
+    CHECK_EQUAL(~(1ull << 1), c.chr_cache.valid[0x101 >> 6]);
+    CHECK_EQUAL(~0ull, c.chr_cache.valid[0]);
+
+    c2C02_invalidate_chr(&c);
+    CHECK_EQUAL(0, c.chr_cache.valid[0]);
+}
+
+TEST(C2C02TestGroup, test_status_stable_until) {
+    memset(&c, 0, sizeof(c));
+    c.bus = &bus;
+    c.scanline = 100;
+    c.clocks = 1000;
+    CHECK_EQUAL(c2C02_clock_at(&c, 241, 0) - 1, c2C02_status_stable_until(&c));  // rendering off: until vblank
+
+    c.mask.show_background = 1;
+    CHECK_EQUAL(1000, c2C02_status_stable_until(&c));  // sprite 0 could hit any dot
+
+    c.scanline = 250;
+    c.status.vblank = 1;
+    CHECK_EQUAL(1000, c2C02_status_stable_until(&c));  // next read clears vblank
+    c.status.vblank = 0;
+    CHECK_EQUAL(c2C02_clock_at(&c, -1, 0) - 1, c2C02_status_stable_until(&c));  // already read: until the next frame
+
+    c.mask.show_background = 0;
+    c.scanline = -1;
+    c.status.sprite_0_hit = 1;
+    CHECK_EQUAL(1000, c2C02_status_stable_until(&c));  // cleared this dot
+}
+
+TEST(C2C02TestGroup, test_fast_forward) {
+    int frames_done = 0;
+    memset(&c, 0, sizeof(c));
+    c.bus = &bus;  // no reads expected: nothing is fetched with rendering off
+    c.frame_done.callback = count_frames;
+    c.frame_done.ctx = &frames_done;
+    c.scanline = 239;
+    c.dot = 100;
+
+    // to vblank being set, across the end of the frame
+    CHECK_EQUAL(241 + 341, c2C02_fast_forward(&c, ~0ull));
+    CHECK_EQUAL(241, c.scanline);
+    CHECK_EQUAL(0, c.dot);
+    CHECK_EQUAL(1, frames_done);
+    CHECK_EQUAL(0, c2C02_fast_forward(&c, ~0ull));
+
+    c2C02_run(&c, c.clocks + 3);
+    CHECK(c.status.vblank);
+    CHECK_EQUAL(7, c2C02_fast_forward(&c, c.clocks + 7));  // up to the given clock at most
+
+    // to the pre-render line clearing vblank, then through the whole picture with rendering off
+    c2C02_fast_forward(&c, ~0ull);
+    CHECK_EQUAL(c2C02_clock_at(&c, -1, 0) - 1, c.clocks);
+    CHECK_EQUAL(1, c.frames);
+    CHECK(c.status.vblank);
+    c2C02_cycle(&c);
+    CHECK_FALSE(c.status.vblank);
+    CHECK_EQUAL(340 + (241 * 341), c2C02_fast_forward(&c, ~0ull));
+    CHECK_EQUAL(241, c.scanline);
+    CHECK_EQUAL(2, frames_done);
+
+    c.scanline = 100;
+    c.dot = 0;
+    c.mask.show_background = 1;
+    CHECK_EQUAL(0, c2C02_fast_forward(&c, ~0ull));  // rendering: every dot counts
+}
+
+TEST(C2C02TestGroup, test_skip_video) {
+    static uint16_t fb_video[C2C02_WIDTH * C2C02_HEIGHT], fb_skip[C2C02_WIDTH * C2C02_HEIGHT];
+    static const uint8_t masks[] = {0x1E, 0x18};  // with and without the left column
+    static const uint8_t sprite_0_x[] = {0, 3, 250};
+    C2C02 video, skip;
+
+    int hits = 0;
+    for (size_t m = 0; m < sizeof(masks); m++) {
+        for (size_t x = 0; x < sizeof(sprite_0_x); x++) {
+            random_scene(&video);
+            video.scanline = 8;
+            video.mask.u8 = masks[m];
+            video.sprite_reg.shifters[0].x = sprite_0_x[x];
+            video.framebuffer = fb_video;
+            memcpy(&skip, &video, sizeof(video));
+            skip.framebuffer = fb_skip;
+            skip.skip_video = true;
+            memset(fb_skip, 0, sizeof(fb_skip));
+
+            c2C02_run(&video, 341 * 4);
+            c2C02_run(&skip, 341 * 4);
+            skip.framebuffer = fb_video;
+            skip.skip_video = false;
+            MEMCMP_EQUAL(&video, &skip, sizeof(video));  // sprite 0 hit included
+            CHECK_EQUAL(0, fb_skip[0]);
+            CHECK_EQUAL(0, fb_skip[(C2C02_WIDTH * C2C02_HEIGHT) - 1]);
+            hits += skip.status.sprite_0_hit;
+        }
+    }
+    CHECK(hits > 0);
+}
+
+TEST(C2C02TestGroup, test_sprite_priority) {
+    static uint16_t fb[C2C02_WIDTH * C2C02_HEIGHT];
+    memset(&c, 0, sizeof(c));
+    memset(vmem, 0, sizeof(vmem));
+    c.bus = &vmem_bus;
+    c.framebuffer = fb;
+    c.mask.u8 = 0x10;  // sprites only, left column clipped
+    c.scanline = 8;
+    for (size_t i = 0; i < sizeof(c.palette_ram); i++) {
+        c.palette_ram[i] = i;
+    }
+    c.sprite_reg.n = 3;
+    c.sprite_reg.shifters[0] = {0x21, 10, 0xFF, 0x00};  // palette 5, behind the background
+    c.sprite_reg.shifters[1] = {0x02, 12, 0x00, 0xFF};  // palette 6, under sprite 0 where they overlap
+    c.sprite_reg.shifters[2] = {0x03, 4, 0xFF, 0xFF};   // palette 7, partly in the clipped column
+
+    c2C02_run(&c, 341);
+    const uint16_t *const row = &fb[8 * C2C02_WIDTH];
+    CHECK_EQUAL(0, row[7]);
+    CHECK_EQUAL((7 << 2) | 3, row[8]);
+    CHECK_EQUAL((5 << 2) | 1, row[10]);
+    CHECK_EQUAL((5 << 2) | 1, row[17]);
+    CHECK_EQUAL((6 << 2) | 2, row[18]);
+    CHECK_EQUAL((6 << 2) | 2, row[19]);
+    CHECK_EQUAL(0, row[20]);
+    CHECK_FALSE(c.status.sprite_0_hit);  // no background to hit
+}
+
+TEST(C2C02TestGroup, test_spans_match_dot_renderer) {
+    static uint16_t fb_span[C2C02_WIDTH * C2C02_HEIGHT], fb_dot[C2C02_WIDTH * C2C02_HEIGHT];
+    C2C02 span, dot;
+
+    for (int i = 0; i < 16; i++) {
+        random_scene(&span);
+        span.scanline = (i & 1) ? 8 : -1;  // visible lines, or the pre-render one
+        srand(i);
+        memcpy(&dot, &span, sizeof(span));
+        span.framebuffer = fb_span;
+        dot.framebuffer = fb_dot;
+
+        // uneven spans, as the bus syncing the ppu mid-line leaves them
+        while (span.clocks < (341 * 3)) {
+            c2C02_run(&span, span.clocks + 1 + (rand() % 120));
+        }
+        while (dot.clocks < span.clocks) {
+            c2C02_cycle(&dot);
+        }
+        dot.framebuffer = fb_span;
+        MEMCMP_EQUAL(&dot, &span, sizeof(span));
+        MEMCMP_EQUAL(fb_dot, fb_span, sizeof(fb_span));
+    }
+}
@@ -0,0 +1,116 @@
+// Instructions per second of c6502_run() over a flat 64K ram bus, with the program in read-only pages. Build with and
+// without C6502_COMPUTED_GOTO / C6502_JIT to compare the dispatchers, e.g. bench_c6502 (op table) vs
+// bench_c6502_computed_goto, and add --block-cache for predecoded blocks (translated in bench_c6502_jit).
+// usage: bench_c6502 [cycles] [--block-cache]
+
+#include <c6502.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint8_t mem[0x10000];
+static const uint8_t *read_pages[0x10000 >> C6502_PAGE_BITS];
+static uint8_t *write_pages[0x10000 >> C6502_PAGE_BITS];
+
+static uint8_t mem_read(void *, uint16_t addr) {
+    return mem[addr];
+}
+
+static bool mem_write(void *, uint16_t addr, uint8_t val) {
+    mem[addr] = val;
+    return true;
+}
+
+static const C6502BusInterface bus = {
+    .read = mem_read,
+    .write = mem_write,
+};
+
+// checksums and shuffles a 256 byte table forever, mixing the common addressing modes
+static const uint8_t program[] = {
+    0xA2, 0x00,        // $8000 reset: LDX #$00
+    0xA9, 0x00,        //       LDA #$00
+    0x85, 0x10,        //       STA $10
+    0xA9, 0x02,        //       LDA #$02
+    0x85, 0x11,        //       STA $11      ; ($10) -> $0200
+    0xA0, 0x00,        // loop: LDY #$00
+    0xB1, 0x10,        // row:  LDA ($10),Y
+    0x18,              //       CLC
+    0x7D, 0x00, 0x03,  //       ADC $0300,X
+    0x0A,              //       ASL A
+    0x65, 0x20,        //       ADC $20
+    0x85, 0x20,        //       STA $20
+    0x99, 0x00, 0x03,  //       STA $0300,Y
+    0x26, 0x21,        //       ROL $21
+    0x20, 0x30, 0x80,  //       JSR mix
+    0xE8,              //       INX
+    0xC8,              //       INY
+    0xD0, 0xE9,        //       BNE row
+    0x4C, 0x0A, 0x80,  //       JMP loop
+};
+
+static const uint8_t mix[] = {
+    0x48,              // $8030 mix: PHA
+    0x8A,              //            TXA
+    0x4D, 0x00, 0x02,  //            EOR $0200
+    0x8D, 0x00, 0x02,  //            STA $0200
+    0x68,              //            PLA
+    0xC9, 0x80,        //            CMP #$80
+    0x90, 0x02,        //            BCC done
+    0x46, 0x20,        //            LSR $20
+    0x60,              // done:      RTS
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void reset(C6502 *const c) {
+    memset(mem, 0, sizeof(mem));
+    memcpy(&mem[0x8000], program, sizeof(program));
+    memcpy(&mem[0x8030], mix, sizeof(mix));
+    mem[0xFFFC] = 0x00;
+    mem[0xFFFD] = 0x80;
+    for (int i = 0; i < 0x100; i++) {
+        mem[0x200 + i] = i * 7;
+    }
+    for (size_t i = 0; i < (0x10000 >> C6502_PAGE_BITS); i++) {
+        read_pages[i] = &mem[i << C6502_PAGE_BITS];
+        write_pages[i] = (i < (0x8000 >> C6502_PAGE_BITS)) ? &mem[i << C6502_PAGE_BITS] : NULL;
+    }
+    c6502_block_cache_deinit(c);
+    memset(c, 0, sizeof(*c));
+    c->bus_interface = &bus;
+    c->read_pages = read_pages;
+    c->write_pages = write_pages;
+    c6502_reset(c);
+}
+
+int main(int argc, char **argv) {
+    const int64_t cycles = (argc > 1) ? atoll(argv[1]) : 200000000;
+    C6502 c = {0};
+
+    // both dispatchers run the same instructions, count them stepping one by one
+    reset(&c);
+    int64_t instructions = 0;
+    for (int64_t n = 0; n < cycles; instructions++) {
+        n += c6502_run_next_instruction(&c);
+    }
+
+    reset(&c);
+    const bool cached = (argc > 2) && (0 == strcmp(argv[2], "--block-cache")) && c6502_block_cache_init(&c);
+    const double start = now();
+    const int64_t ran = c6502_run(&c, cycles);
+    const double elapsed = now() - start;
+
+    printf("%lld instructions, %lld cycles in %.3fs: %.1f M instructions/s\n", (long long)instructions,
+           (long long)ran, elapsed, instructions / elapsed / 1e6);
+    if (cached) {
+        printf("block cache: %llu hits, %llu misses\n", (unsigned long long)c.block_cache_stats.hits,
+               (unsigned long long)c.block_cache_stats.misses);
+    }
+    return 0;
+}
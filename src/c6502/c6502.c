@@ -1,27 +1,74 @@
 #include <c6502.h>
 #include <stddef.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(C6502_JIT) && defined(__x86_64__) && defined(__unix__) && !defined(__EMSCRIPTEN__)
+#define C6502_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
 static const uint16_t RESET_ADDR = 0xFFFC;
 static const uint8_t RESET_SP = 0xFD;
 static const uint16_t STACK_BASE = 0x100;
 static const uint16_t IRQ_ADDR = 0xFFFE;
 static const uint16_t NMI_ADDR = 0xFFFA;
 
-/** read a byte from the bus at the specified address */
+// status register bits kept in flags.other
+static const uint8_t STATUS_I = 0x04;
+static const uint8_t STATUS_D = 0x08;
+static const uint8_t STATUS_B = 0x10;
+static const uint8_t STATUS_UNUSED = 0x20;
+
+/** puts the status register together from the lazily kept flags */
+inline static C6502Status status(const C6502 *const c) {
+    return (C6502Status){
+        .u8 = (c->flags.n & 0x80) | (c->flags.v << 6) | c->flags.other | (c->flags.z << 1) | c->flags.c,
+    };
+}
+
+inline static void set_status(C6502 *const c, const uint8_t sr) {
+    const C6502Status bits = {.u8 = sr};
+    c->flags.n = sr;
+    c->flags.z = bits.Z;
+    c->flags.c = bits.C;
+    c->flags.v = bits.V;
+    c->flags.other = sr & (STATUS_I | STATUS_D | STATUS_B | STATUS_UNUSED);
+}
+
+/** read a byte from the bus at the specified address. Mapped pages (zero page and stack on most systems) are plain
+ * loads, the rest goes through the bus interface */
 inline static uint8_t read(const C6502 *const c, const uint16_t addr) {
+    if (c->read_pages) {
+        const uint8_t *const page = c->read_pages[addr >> C6502_PAGE_BITS];
+        if (page) {
+            return page[addr & (C6502_PAGE_SIZE - 1)];
+        }
+    }
     return c->bus_interface->read(c->bus_ctx, addr);
 }
 
-/** write a byte to the bus at the specified address */
-inline static bool write(const C6502 *const c, const uint16_t addr, const uint8_t val) {
+/** write a byte to the bus at the specified address, same as read(). Writes through the bus interface are counted:
+ * they may switch banks under the block cache */
+inline static bool write(C6502 *const c, const uint16_t addr, const uint8_t val) {
+    if (c->write_pages) {
+        uint8_t *const page = c->write_pages[addr >> C6502_PAGE_BITS];
+        if (page) {
+            page[addr & (C6502_PAGE_SIZE - 1)] = val;
+            return true;
+        }
+    }
+    c->bus_writes++;
     return c->bus_interface->write(c->bus_ctx, addr, val);
 }
 
 /** read a byte from the bus at the specified address and write it back.
  * some instructions just do this before a read-modify-write
  * https://www.nesdev.org/6502_cpu.txt */
-inline static uint8_t read_write(const C6502 *const c, const uint16_t addr) {
-    const uint8_t ret = c->bus_interface->read(c->bus_ctx, addr);
+inline static uint8_t read_write(C6502 *const c, const uint16_t addr) {
+    const uint8_t ret = read(c, addr);
     write(c, addr, ret);
     return ret;
 }
@@ -114,67 +161,64 @@ static uint16_t AM_ABS(C6502 *const c, const Op *) {
     return read_u16_pc(c);
 }
 
-/** Absolute w/ X offset - full 16b addr +X */
-static uint16_t AM_ABX(C6502 *const c, const Op *const op) {
-    const uint16_t addr = read_u16_pc(c);
-    const uint16_t ret = addr + c->X;
+/** base address + index register, one extra cycle on page break for some ops */
+inline static uint16_t indexed(C6502 *const c, const Op *const op, const uint16_t addr, const uint8_t index) {
+    const uint16_t ret = addr + index;
     if (op->page_break_extra_cycle && page_break(ret, addr)) {
         c->current_op_cycles_remaining++;
     }
     return ret;
 }
 
+/** Absolute w/ X offset - full 16b addr +X */
+static uint16_t AM_ABX(C6502 *const c, const Op *const op) {
+    return indexed(c, op, read_u16_pc(c), c->X);
+}
+
 /** Absolute w/ Y offset - full 16b addr +Y */
 static uint16_t AM_ABY(C6502 *const c, const Op *const op) {
-    const uint16_t addr = read_u16_pc(c);
-    const uint16_t ret = addr + c->Y;
-    if (op->page_break_extra_cycle && page_break(ret, addr)) {
-        c->current_op_cycles_remaining++;
-    }
-    return ret;
+    return indexed(c, op, read_u16_pc(c), c->Y);
 }
 
-/** Indirect - 16b pointer */
-static uint16_t AM_IND(C6502 *const c, const Op *) {
-    const uint16_t ptr = read_u16_pc(c);
+inline static uint16_t indirect(const C6502 *const c, const uint16_t ptr) {
     const uint16_t lo = read(c, ptr);
     // emulate page-wrap bug when reading from xxFF
     const uint16_t hi = read(c, (ptr & 0xFF00) | ((ptr + 1) & 0xFF));
     return (hi << 8) | lo;
 }
 
-/** Indirect w/ X offset - 16b pointer +X */
-static uint16_t AM_INX(C6502 *const c, const Op *) {
-    uint8_t zpi = read(c, c->PC++) + c->X;  // add to x (no carry)
+/** Indirect - 16b pointer */
+static uint16_t AM_IND(C6502 *const c, const Op *) {
+    return indirect(c, read_u16_pc(c));
+}
+
+inline static uint16_t zp_indirect(const C6502 *const c, uint8_t zpi) {
     const uint16_t lo = read(c, zpi++);
     const uint16_t hi = read(c, zpi);  // 2nd byte may wrap around to start of zero-page
     return (hi << 8) | lo;
 }
 
+/** Indirect w/ X offset - 16b pointer +X */
+static uint16_t AM_INX(C6502 *const c, const Op *) {
+    return zp_indirect(c, read(c, c->PC++) + c->X);  // add to x (no carry)
+}
+
 /** */
 static uint16_t AM_INY(C6502 *const c, const Op *const op) {
-    uint8_t zpi = read(c, c->PC++);
-    const uint16_t lo = read(c, zpi++);
-    const uint16_t hi = read(c, zpi);  // 2nd byte may wrap around to start of zero-page
-    const uint16_t addr = (hi << 8) | lo;
-    const uint16_t ret = addr + c->Y;
-    if (op->page_break_extra_cycle && page_break(ret, addr)) {
-        c->current_op_cycles_remaining++;
-    }
-    return ret;
+    return indexed(c, op, zp_indirect(c, read(c, c->PC++)), c->Y);
 }
 
 ////////////////////
 
 static void update_ZN(C6502 *const c, uint8_t val) {
-    c->SR.Z = (0 == val) ? 1 : 0;
-    c->SR.N = val >> 7;
+    c->flags.z = (0 == val);
+    c->flags.n = val;
 }
 
 static void add(C6502 *const c, const uint8_t val) {
-    const uint16_t sum = c->AC + val + c->SR.C;
-    c->SR.V = ((c->AC ^ sum) & (val ^ sum)) >> 7;
-    c->SR.C = sum >> 8;
+    const uint16_t sum = c->AC + val + c->flags.c;
+    c->flags.v = (((c->AC ^ sum) & (val ^ sum)) >> 7) & 1;
+    c->flags.c = sum >> 8;
     c->AC = sum;
     update_ZN(c, c->AC);
 }
@@ -189,7 +233,7 @@ static void OP_AND(C6502 *const c, const Op *) {
 }
 
 static uint8_t shift_left(C6502 *const c, uint8_t val) {
-    c->SR.C = val >> 7;
+    c->flags.c = val >> 7;
     val <<= 1;
     update_ZN(c, val);
     return val;
@@ -216,87 +260,84 @@ static void branch_if(C6502 *const c, const bool cond) {
 
 /** branch on carry clear */
 static void OP_BCC(C6502 *const c, const Op *) {
-    branch_if(c, (0 == c->SR.C));
+    branch_if(c, (0 == c->flags.c));
 }
 
 /** branch on carry set*/
 static void OP_BCS(C6502 *const c, const Op *) {
-    branch_if(c, (0 != c->SR.C));
+    branch_if(c, (0 != c->flags.c));
 }
 
 /** branch on result 0 */
 static void OP_BEQ(C6502 *const c, const Op *) {
-    branch_if(c, (0 != c->SR.Z));
+    branch_if(c, (0 != c->flags.z));
 }
 
 static void OP_BIT(C6502 *const c, const Op *) {
     const uint8_t val = read(c, c->addr);
-    const uint8_t result = c->AC & val;
-    c->SR.Z = (0 == result) ? 1 : 0;
-    c->SR.N = val >> 7;
-    c->SR.V = (val >> 6) & 1;
+    c->flags.z = (0 == (c->AC & val));
+    c->flags.n = val;
+    c->flags.v = (val >> 6) & 1;
 }
 
 /** branch on result minus */
 static void OP_BMI(C6502 *const c, const Op *) {
-    branch_if(c, (0 != c->SR.N));
+    branch_if(c, (0 != (c->flags.n & 0x80)));
 }
 
 /** branch on result not zero */
 static void OP_BNE(C6502 *const c, const Op *) {
-    branch_if(c, (0 == c->SR.Z));
+    branch_if(c, (0 == c->flags.z));
 }
 
 /** branch on result positive*/
 static void OP_BPL(C6502 *const c, const Op *) {
-    branch_if(c, (0 == c->SR.N));
+    branch_if(c, (0 == (c->flags.n & 0x80)));
 }
 
 /** software interrupt */
 static void OP_BRK(C6502 *const c, const Op *) {
     c->PC++;
-    c->SR.I = 1;
+    c->flags.other |= STATUS_I;
     stack_push_u16(c, c->PC);
-    c->SR.B = 1;
-    stack_push(c, c->SR.u8);
-    c->SR.B = 0;
+    stack_push(c, status(c).u8 | STATUS_B);
     c->PC = read_u16(c, IRQ_ADDR);
 }
 
 /** branch on carry clear */
 static void OP_BVC(C6502 *const c, const Op *) {
-    branch_if(c, (0 == c->SR.V));
+    branch_if(c, (0 == c->flags.v));
 }
 
 /** branch on carry set */
 static void OP_BVS(C6502 *const c, const Op *) {
-    branch_if(c, (0 != c->SR.V));
+    branch_if(c, (0 != c->flags.v));
 }
 
 /** clear carry flag */
 static void OP_CLC(C6502 *const c, const Op *) {
-    c->SR.C = 0;
+    c->flags.c = 0;
 }
 
 /** clear decimal flag*/
 static void OP_CLD(C6502 *const c, const Op *) {
-    c->SR.D = 0;
+    c->flags.other &= ~STATUS_D;
 }
 
 /** clear interrupt-disable flag */
 static void OP_CLI(C6502 *const c, const Op *) {
-    c->SR.I = 0;
+    c->flags.other &= ~STATUS_I;
 }
 
 /** clear overflow flag */
 static void OP_CLV(C6502 *const c, const Op *) {
-    c->SR.V = 0;
+    c->flags.v = 0;
 }
 
 static void cmp_reg(C6502 *const c, const uint8_t reg) {
     const uint8_t mem = read(c, c->addr);
     const uint8_t sub = reg - mem;
-    c->SR.C = (reg >= mem) ? 1 : 0;
+    c->flags.c = (reg >= mem) ? 1 : 0;
     update_ZN(c, sub);
 }
 
@@ -377,7 +418,7 @@ static void OP_LDY(C6502 *const c, const Op *) {
 }
 
 static uint8_t shift_right(C6502 *const c, uint8_t val) {
-    c->SR.C = val & 1;
+    c->flags.c = val & 1;
     val >>= 1;
     update_ZN(c, val);
     return val;
@@ -405,10 +446,7 @@ static void OP_PHA(C6502 *const c, const Op *) {
 }
 
 static void OP_PHP(C6502 *const c, const Op *) {
-    typeof(c->SR) sr = c->SR;
-    sr.B = 1;
-    sr._unused = 1;
-    stack_push(c, sr.u8);
+    stack_push(c, status(c).u8 | STATUS_B | STATUS_UNUSED);
 }
 
 static void OP_PLA(C6502 *const c, const Op *) {
@@ -417,16 +455,13 @@ static void OP_PLA(C6502 *const c, const Op *) {
 }
 
 static void OP_PLP(C6502 *const c, const Op *) {
-    typeof(c->SR) sr = c->SR;
-
-    c->SR.u8 = stack_pop(c);
-    c->SR._unused = sr._unused;
-    c->SR.B = sr.B;
+    const uint8_t kept = c->flags.other & (STATUS_B | STATUS_UNUSED);
+    set_status(c, (stack_pop(c) & ~(STATUS_B | STATUS_UNUSED)) | kept);
 }
 
 static uint8_t rotate_left(C6502 *const c, const uint8_t val) {
-    const uint8_t shifted = c->SR.C | (val << 1);
-    c->SR.C = val >> 7;
+    const uint8_t shifted = c->flags.c | (val << 1);
+    c->flags.c = val >> 7;
     update_ZN(c, shifted);
     return shifted;
 }
@@ -440,8 +475,8 @@ static void OP_ROL(C6502 *const c, const Op *const op) {
 }
 
 static uint8_t rotate_right(C6502 *const c, const uint8_t val) {
-    const uint8_t shifted = (c->SR.C << 7) | (val >> 1);
-    c->SR.C = val & 1;
+    const uint8_t shifted = (c->flags.c << 7) | (val >> 1);
+    c->flags.c = val & 1;
     update_ZN(c, shifted);
     return shifted;
 }
@@ -455,10 +490,8 @@ static void OP_ROR(C6502 *const c, const Op *const op) {
 }
 
 static void OP_RTI(C6502 *const c, const Op *) {
-    typeof(c->SR) sr_prev = c->SR;
-    c->SR.u8 = stack_pop(c);
-    c->SR.B = sr_prev.B;
-    c->SR._unused = sr_prev._unused;
+    const uint8_t kept = c->flags.other & (STATUS_B | STATUS_UNUSED);
+    set_status(c, (stack_pop(c) & ~(STATUS_B | STATUS_UNUSED)) | kept);
     c->PC = stack_pop_u16(c);
 }
 
@@ -467,9 +500,9 @@ static void OP_RTS(C6502 *const c, const Op *) {
 }
 
 static void sub(C6502 *const c, const uint8_t val) {
-    const uint16_t diff = c->AC - val - (c->SR.C ^ 1);
-    c->SR.C = (diff >> 8) ^ 1;
-    c->SR.V = ((c->AC ^ diff) & (~val ^ diff)) >> 7;
+    const uint16_t diff = c->AC - val - (c->flags.c ^ 1);
+    c->flags.c = ((diff >> 8) ^ 1) & 1;
+    c->flags.v = (((c->AC ^ diff) & (~val ^ diff)) >> 7) & 1;
     c->AC = diff;
     update_ZN(c, c->AC);
 }
@@ -479,15 +512,15 @@ static void OP_SBC(C6502 *const c, const Op *) {
 }
 
 static void OP_SEC(C6502 *const c, const Op *) {
-    c->SR.C = 1;
+    c->flags.c = 1;
 }
 
 static void OP_SED(C6502 *const c, const Op *) {
-    c->SR.D = 1;
+    c->flags.other |= STATUS_D;
 }
 
 static void OP_SEI(C6502 *const c, const Op *) {
-    c->SR.I = 1;
+    c->flags.other |= STATUS_I;
 }
 
 /** store accumulator */
@@ -585,6 +618,74 @@ static void OP_RRA(C6502 *const c, const Op *) {
     add(c, val);
 }
 
+/** AND, then bit 7 into carry */
+static void OP_ANC(C6502 *const c, const Op *) {
+    c->AC &= read(c, c->addr);
+    update_ZN(c, c->AC);
+    c->flags.c = c->AC >> 7;
+}
+
+/** AND, then LSR A */
+static void OP_ALR(C6502 *const c, const Op *) {
+    c->AC = shift_right(c, c->AC & read(c, c->addr));
+}
+
+/** AND, then ROR A, with carry from bit 6 of the result and overflow from bit 6 xor bit 5 */
+static void OP_ARR(C6502 *const c, const Op *) {
+    c->AC = rotate_right(c, c->AC & read(c, c->addr));
+    c->flags.c = (c->AC >> 6) & 1;
+    c->flags.v = ((c->AC >> 6) ^ (c->AC >> 5)) & 1;
+}
+
+/** X = (A & X) - operand, flags as for CMP */
+static void OP_AXS(C6502 *const c, const Op *) {
+    const uint8_t ax = c->AC & c->X;
+    const uint8_t m = read(c, c->addr);
+    c->flags.c = ax >= m;
+    c->X = ax - m;
+    update_ZN(c, c->X);
+}
+
+/** A, X and SP = memory & SP */
+static void OP_LAS(C6502 *const c, const Op *) {
+    c->AC = c->X = c->SP = read(c, c->addr) & c->SP;
+    update_ZN(c, c->AC);
+}
+
+/** the unstable stores, the way most 6502s do them: val & (high byte of the base address + 1). Indexing across a page
+ * puts that in the address' high byte as well */
+static void store_and_high(C6502 *const c, const uint8_t val, const uint8_t index) {
+    const uint16_t base = c->addr - index;
+    const uint8_t stored = val & ((base >> 8) + 1);
+    write(c, page_break(c->addr, base) ? ((stored << 8) | (c->addr & 0xFF)) : c->addr, stored);
+}
+
+/** AHX: A & X & (H+1) */
+static void OP_SHA(C6502 *const c, const Op *) {
+    store_and_high(c, c->AC & c->X, c->Y);
+}
+
+/** SP = A & X, then stores SP & (H+1) */
+static void OP_TAS(C6502 *const c, const Op *) {
+    c->SP = c->AC & c->X;
+    store_and_high(c, c->SP, c->Y);
+}
+
+static void OP_SHY(C6502 *const c, const Op *) {
+    store_and_high(c, c->Y, c->X);
+}
+
+static void OP_SHX(C6502 *const c, const Op *) {
+    store_and_high(c, c->X, c->Y);
+}
+
+/** KIL: a real 6502 stops fetching, with its bus stuck, until reset. This one runs the same opcode over and over, so
+ * time goes on for the rest of the system (and the block cache skips it as an idle loop). Interrupts still get
+ * through */
+static void OP_JAM(C6502 *const c, const Op *) {
+    c->PC--;
+}
+
 static const Op optable[0x100] = {
     [0x00] = {OP_BRK, AM_IMP, 7},
     [0x10] = {OP_BPL, AM_REL, 2},  //''
@@ -620,15 +721,22 @@ static const Op optable[0x100] = {
     [0xE1] = {OP_SBC, AM_INX, 6},
     [0xF1] = {OP_SBC, AM_INY, 5, .page_break_extra_cycle = true},
 
-    // ...
+    [0x02] = {OP_JAM, AM_IMP, 2},
+    [0x12] = {OP_JAM, AM_IMP, 2},
+    [0x22] = {OP_JAM, AM_IMP, 2},
+    [0x32] = {OP_JAM, AM_IMP, 2},
+    [0x42] = {OP_JAM, AM_IMP, 2},
+    [0x52] = {OP_JAM, AM_IMP, 2},
+    [0x62] = {OP_JAM, AM_IMP, 2},
+    [0x72] = {OP_JAM, AM_IMP, 2},
     [0x82] = {OP_NOP, AM_IMM, 2},
-    //
+    [0x92] = {OP_JAM, AM_IMP, 2},
     [0xA2] = {OP_LDX, AM_IMM, 2},
-    //
+    [0xB2] = {OP_JAM, AM_IMP, 2},
     [0xC2] = {OP_NOP, AM_IMM, 2},
-    //
+    [0xD2] = {OP_JAM, AM_IMP, 2},
     [0xE2] = {OP_NOP, AM_IMM, 2},
-    //
+    [0xF2] = {OP_JAM, AM_IMP, 2},
 
     [0x03] = {OP_SLO, AM_INX, 8},
     [0x13] = {OP_SLO, AM_INY, 8},
@@ -639,7 +747,7 @@ static const Op optable[0x100] = {
     [0x63] = {OP_RRA, AM_INX, 8},
     [0x73] = {OP_RRA, AM_INY, 8},
     [0x83] = {OP_SAX, AM_INX, 6},
-    //
+    [0x93] = {OP_SHA, AM_INY, 6},  // AHX, unstable: the common & (H+1) store, see store_and_high()
     [0xA3] = {OP_LAX, AM_INX, 6},
     [0xB3] = {OP_LAX, AM_INY, 5, .page_break_extra_cycle = true},
     [0xC3] = {OP_DCP, AM_INX, 8},
@@ -767,16 +875,19 @@ static const Op optable[0x100] = {
     [0xFA] = {OP_NOP, AM_IMP, 2},
 
     // xB
+    [0x0B] = {OP_ANC, AM_IMM, 2},
     [0x1B] = {OP_SLO, AM_ABY, 7},
+    [0x2B] = {OP_ANC, AM_IMM, 2},
     [0x3B] = {OP_RLA, AM_ABY, 7},
+    [0x4B] = {OP_ALR, AM_IMM, 2},
     [0x5B] = {OP_SRE, AM_ABY, 7},
-    //
+    [0x6B] = {OP_ARR, AM_IMM, 2},
     [0x7B] = {OP_RRA, AM_ABY, 7},
-    //
-    //
+    [0x8B] = {OP_NOP, AM_IMM, 2},  // XAA, unstable
+    [0x9B] = {OP_TAS, AM_ABY, 5},  // unstable: the common & (H+1) store, see store_and_high()
     [0xAB] = {OP_LAX, AM_IMM, 2},
-    //
-    //
+    [0xBB] = {OP_LAS, AM_ABY, 4, .page_break_extra_cycle = true},
+    [0xCB] = {OP_AXS, AM_IMM, 2},
     [0xDB] = {OP_DCP, AM_ABY, 7},
     [0xEB] = {OP_SBC, AM_IMM, 2},
     [0xFB] = {OP_ISC, AM_ABY, 7},
@@ -790,7 +901,7 @@ static const Op optable[0x100] = {
     [0x6C] = {OP_JMP, AM_IND, 5},
     [0x7C] = {OP_NOP, AM_ABX, 4, .page_break_extra_cycle = true},
     [0x8C] = {OP_STY, AM_ABS, 4},
-    // [0x9C] = {},
+    [0x9C] = {OP_SHY, AM_ABX, 5},  // unstable: the common & (H+1) store, see store_and_high()
     [0xAC] = {OP_LDY, AM_ABS, 4},
     [0xBC] = {OP_LDY, AM_ABX, 4, .page_break_extra_cycle = true},
     [0xCC] = {OP_CPY, AM_ABS, 4},
@@ -824,7 +935,7 @@ static const Op optable[0x100] = {
     [0x6E] = {OP_ROR, AM_ABS, 6},
     [0x7E] = {OP_ROR, AM_ABX, 7},
     [0x8E] = {OP_STX, AM_ABS, 4},
-    // [0x9E] = {},
+    [0x9E] = {OP_SHX, AM_ABY, 5},  // unstable: the common & (H+1) store, see store_and_high()
     [0xAE] = {OP_LDX, AM_ABS, 4},
     [0xBE] = {OP_LDX, AM_ABY, 4, .page_break_extra_cycle = true},
     [0xCE] = {OP_DEC, AM_ABS, 6},
@@ -841,7 +952,7 @@ static const Op optable[0x100] = {
     [0x6F] = {OP_RRA, AM_ABS, 6},
     [0x7F] = {OP_RRA, AM_ABX, 7},
     [0x8F] = {OP_SAX, AM_ABS, 4},
-    //
+    [0x9F] = {OP_SHA, AM_ABY, 5},  // AHX, unstable: the common & (H+1) store, see store_and_high()
     [0xAF] = {OP_LAX, AM_ABS, 4},
     [0xBF] = {OP_LAX, AM_ABY, 4, .page_break_extra_cycle = true},
     [0xCF] = {OP_DCP, AM_ABS, 6},
@@ -853,12 +964,131 @@ static const Op optable[0x100] = {
 
 static void handle_interrupt(C6502 *const c, uint16_t isr_addr) {
     stack_push_u16(c, c->PC);
-    stack_push(c, c->SR.u8);
-    c->SR.I = 1;
+    stack_push(c, status(c).u8);
+    c->flags.other |= STATUS_I;
     c->PC = read_u16(c, isr_addr);
     c->current_op_cycles_remaining = 7;  // ToDo - confirm cycles
 }
 
+#ifdef C6502_PROFILE
+
+#define PROFILE_PCS (1 << 16)  // per-pc entries, a power of two
+
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t page_crossings;  // taken the extra cycle for crossing a page (branches: taken to another page)
+} ProfileCounts;
+
+typedef struct {
+    const uint8_t *code;  // host address of the opcode, tells banks mapped at the same pc apart. NULL if not mapped
+    uint16_t pc;
+    uint8_t opcode;
+    bool used;
+    ProfileCounts counts;
+} ProfilePc;
+
+struct C6502Profile {
+    ProfileCounts opcodes[0x100];
+    ProfilePc pcs[PROFILE_PCS];  // open addressing on pc and code
+    uint64_t pcs_dropped;        // instructions not counted per pc because pcs was full
+};
+
+static ProfilePc *profile_pc(struct C6502Profile *const p, const uint16_t pc, const uint8_t *const code) {
+    const uint32_t hash = (pc ^ ((uintptr_t)code >> C6502_PAGE_BITS) * 0x9E3779B1u) & (PROFILE_PCS - 1);
+    for (uint32_t i = 0; i < PROFILE_PCS; i++) {
+        ProfilePc *const entry = &p->pcs[(hash + i) & (PROFILE_PCS - 1)];
+        if (!entry->used || ((entry->pc == pc) && (entry->code == code))) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void profile_counts(ProfileCounts *const counts, const int cycles, const bool page_crossed) {
+    counts->count++;
+    counts->cycles += cycles;
+    counts->page_crossings += page_crossed;
+}
+
+/** counts the instruction at pc that just ran, before FINISH_OP() or the like resets current_op_cycles_remaining */
+__attribute__((noinline)) static void profile_op(C6502 *const c, const uint8_t opcode, const uint16_t pc) {
+    struct C6502Profile *const p = c->profile;
+    if (NULL == p) {
+        return;
+    }
+    const Op *const op = &optable[opcode];
+    const int cycles = c->current_op_cycles_remaining;
+    const bool page_crossed = (AM_REL == op->address_mode_handler)
+                                  ? (cycles >= op->cycles + 2)  // taken, to another page
+                                  : (op->page_break_extra_cycle && (cycles > op->cycles));
+    profile_counts(&p->opcodes[opcode], cycles, page_crossed);
+
+    const uint8_t *const page = c->read_pages ? c->read_pages[pc >> C6502_PAGE_BITS] : NULL;
+    const uint8_t *const code = page ? &page[pc & (C6502_PAGE_SIZE - 1)] : NULL;
+    ProfilePc *const entry = profile_pc(p, pc, code);
+    if (NULL == entry) {
+        p->pcs_dropped++;
+        return;
+    }
+    if (!entry->used) {
+        *entry = (ProfilePc){.code = code, .pc = pc, .opcode = opcode, .used = true};
+    }
+    profile_counts(&entry->counts, cycles, page_crossed);
+}
+
+#define PROFILE_START(pc) const uint16_t profile_pc_ = (pc)
+#define PROFILE_OP(opcode) profile_op(c, (opcode), profile_pc_)
+
+#else
+
+#define PROFILE_START(pc) (void)0
+#define PROFILE_OP(opcode) (void)0
+
+#endif
+
+/** instruction length in bytes, from its address mode */
+inline static int op_length(const Op *const op) {
+    if ((AM_ABS == op->address_mode_handler) || (AM_ABX == op->address_mode_handler) ||
+        (AM_ABY == op->address_mode_handler) || (AM_IND == op->address_mode_handler)) {
+        return 3;
+    }
+    if ((AM_IMP == op->address_mode_handler) || (AM_ACC == op->address_mode_handler)) {
+        return 1;
+    }
+    return 2;
+}
+
+_Static_assert(sizeof(C6502TraceRecord) == 24, "trace files depend on the layout");
+
+/** appends the instruction whose opcode was just fetched to the trace. total_cycles has already counted its first
+ * cycle. Its operand is only looked up in mapped pages, reading it through the bus could have side effects: it's 0
+ * elsewhere */
+__attribute__((noinline)) static void trace(C6502 *const c, const uint8_t opcode) {
+    C6502Trace *const t = c->trace;
+    C6502TraceRecord *const record = &t->records[t->written % t->capacity];
+    *record = (C6502TraceRecord){
+        .cycle = c->total_cycles - 1,
+        .pc = c->PC - 1,
+        .bytes = {opcode},
+        .length = op_length(&optable[opcode]),
+        .a = c->AC,
+        .x = c->X,
+        .y = c->Y,
+        .p = status(c).u8,
+        .sp = c->SP,
+    };
+    for (int i = 1; i < record->length; i++) {
+        const uint16_t addr = record->pc + i;
+        const uint8_t *const page = c->read_pages ? c->read_pages[addr >> C6502_PAGE_BITS] : NULL;
+        record->bytes[i] = page ? page[addr & (C6502_PAGE_SIZE - 1)] : 0;
+    }
+    if (c->bus_interface->trace_position) {
+        c->bus_interface->trace_position(c->bus_ctx, record->cycle, &record->scanline, &record->dot);
+    }
+    t->written++;
+}
+
 static void fetch_and_execute(C6502 *const c) {
     if (c->nmi) {
         c->nmi = false;
@@ -867,45 +1097,564 @@ static void fetch_and_execute(C6502 *const c) {
     }
     if (c->irq) {
         c->irq = false;
-        if (0 == c->SR.I) {
+        if (0 == (c->flags.other & STATUS_I)) {
             handle_interrupt(c, IRQ_ADDR);
             return;
         }
     }
 
-    const Op *const op = &optable[read(c, c->PC++)];
-    if ((NULL == op->address_mode_handler) || (NULL == op->op_handler)) {
-        return;
+    PROFILE_START(c->PC);
+    const uint8_t opcode = read(c, c->PC++);
+    if (c->trace) {
+        trace(c, opcode);
     }
-    // ToDo: check op->cycles > 0
+    const Op *const op = &optable[opcode];
     c->current_op_cycles_remaining = op->cycles;
     c->addr = op->address_mode_handler(c, op);
     op->op_handler(c, op);
+    PROFILE_OP(opcode);
 }
 
-void c6502_cycle(C6502 *const c) {
-    c->total_cycles++;
-    if (0 == c->current_op_cycles_remaining) {
+/** runs the next instruction or interrupt, or whatever stall is pending. returns the cycles it took */
+static int step(C6502 *const c) {
+    int cycles = c->current_op_cycles_remaining;
+    if (0 == cycles) {
+        c->total_cycles++;  // bus sees the first cycle of the instruction, same as it would stepping per-cycle
         fetch_and_execute(c);
+        cycles = c->current_op_cycles_remaining;  // every opcode has an entry, see OP_JAM() for the ones that halt
+        c->total_cycles += cycles - 1;
+    } else {
+        c->total_cycles += cycles;
     }
-    c->current_op_cycles_remaining--;
+    c->current_op_cycles_remaining = 0;
+    return cycles;
 }
 
-int c6502_run_next_instruction(C6502 *const c) {
-    int ret = 0;
+/** c6502_run() one step() at a time */
+static int64_t stepped_run(C6502 *const c, const int64_t cycle_budget) {
+    int64_t cycles = 0;
+    while (cycles < cycle_budget) {
+        cycles += step(c);
+        if (c->nmi || c->irq) {
+            break;  // serviced at the start of the next run
+        }
+    }
+    return cycles;
+}
+
+/** runs optable[n]. With a constant n the table entry folds away, so the address mode and op handlers are inlined,
+ * and checks like AM_ACC == op->address_mode_handler disappear */
+#define EXECUTE_OP(n)                                  \
+    do {                                               \
+        const Op *const op = &optable[n];              \
+        c->current_op_cycles_remaining = op->cycles;   \
+        c->addr = op->address_mode_handler(c, op);     \
+        op->op_handler(c, op);                         \
+    } while (0)
+
+/** account for the instruction that just ran, same as step() */
+#define FINISH_OP()                                            \
+    do {                                                       \
+        c->total_cycles += c->current_op_cycles_remaining - 1; \
+        c->current_op_cycles_remaining = 0;                    \
+    } while (0)
+
+#define FOR_EACH_NIBBLE(m) \
+    m(0x0) m(0x1) m(0x2) m(0x3) m(0x4) m(0x5) m(0x6) m(0x7) m(0x8) m(0x9) m(0xA) m(0xB) m(0xC) m(0xD) m(0xE) m(0xF)
+#define FOR_EACH_OPCODE(m, hi)                                                                                  \
+    m(hi##0) m(hi##1) m(hi##2) m(hi##3) m(hi##4) m(hi##5) m(hi##6) m(hi##7) m(hi##8) m(hi##9) m(hi##A) m(hi##B) \
+    m(hi##C) m(hi##D) m(hi##E) m(hi##F)
+
+__attribute__((noinline)) static int64_t cached_run(C6502 *, int64_t cycle_budget);
+
+#ifdef C6502_COMPUTED_GOTO
+
+/** one fused handler per opcode, dispatching the next one straight from its end */
+#define FUSED_OP(n)                                                    \
+    op_##n : {                                                         \
+        PROFILE_START(c->PC - 1); /* past the opcode */                \
+        EXECUTE_OP(n);                                                 \
+        PROFILE_OP(n);                                                 \
+        cycles += c->current_op_cycles_remaining;                      \
+        FINISH_OP();                                                   \
+        if ((cycles >= cycle_budget) || c->nmi || c->irq) {            \
+            return cycles; /* serviced at the start of the next run */ \
+        }                                                              \
+        c->total_cycles++;                                             \
+        goto *dispatch_table[read(c, c->PC++)];                        \
+    }
+#define FUSED_OPS(hi) FOR_EACH_OPCODE(FUSED_OP, hi)
+#define OP_LABEL(n) [n] = &&op_##n,
+#define OP_LABELS(hi) FOR_EACH_OPCODE(OP_LABEL, hi)
+
+__attribute__((flatten)) int64_t c6502_run(C6502 *const c, const int64_t cycle_budget) {
+    static const void *const dispatch_table[0x100] = {FOR_EACH_NIBBLE(OP_LABELS)};
+
+    if (cycle_budget <= 0) {
+        return 0;
+    }
+    if (c->trace) {
+        return stepped_run(c, cycle_budget);
+    }
+    if (c->block_cache) {
+        return cached_run(c, cycle_budget);
+    }
+    int64_t cycles = 0;
+    if (c->current_op_cycles_remaining || c->nmi || c->irq) {
+        cycles += step(c);  // pending stall or interrupt
+        if ((cycles >= cycle_budget) || c->nmi || c->irq) {
+            return cycles;
+        }
+    }
+    c->total_cycles++;  // bus sees the first cycle of the instruction, same as in step()
+    goto *dispatch_table[read(c, c->PC++)];
+
+    FOR_EACH_NIBBLE(FUSED_OPS)
+}
+
+#else
+
+int64_t c6502_run(C6502 *const c, const int64_t cycle_budget) {
+    if (c->block_cache && !c->trace && (cycle_budget > 0)) {
+        return cached_run(c, cycle_budget);
+    }
+    return stepped_run(c, cycle_budget);
+}
+
+#endif
+
+// Block cache: straight-line code in read-only pages (prg-rom) is predecoded into the handler for each opcode plus its
+// operand bytes, and runs without fetching and dispatching through the bus. Data accesses of the instructions stay on
+// the bus at the same cycles as in the interpreter, which keeps register and mapper i/o exact. Blocks are keyed by the
+// host address of their first byte: a bank switch points the page somewhere else, and the old blocks stay valid for
+// when the bank comes back. With C6502_JIT, each block is also translated into x86-64 calling the handlers in turn.
+// Blocks that only read memory and branch back to themselves may be idle loops waiting for an interrupt or i/o, see
+// run_idle_block().
+
+#define BLOCK_CACHE_SIZE 4096  // direct mapped
+#define BLOCK_MAX_OPS 32
+#define JIT_CODE_SIZE (1 << 20)
+#define JIT_PAGE_SIZE 4096  // x86-64's, what mprotect() works in
+#define JIT_MAX_OP_CODE 42  // bytes of x86-64 per instruction, at most
+#define JIT_BLOCK_CODE_OVERHEAD 6
+#ifdef C6502_PROFILE
+#define JIT_MIN_FOLDED_OPS (BLOCK_MAX_OPS + 1)  // none, profiles count every instruction as it runs
+#else
+#define JIT_MIN_FOLDED_OPS 2  // register_only() instructions in a row that the jit counts cycles for at once
+#endif
+
+typedef struct {
+    bool (*run)(C6502 *, uint16_t operand);  // returns true when the block has to stop
+    uint16_t operand;
+    uint8_t opcode;
+} DecodedOp;
+
+typedef struct {
+    const uint8_t *key;  // NULL for an empty slot
+    void (*native)(C6502 *);
+    int count;
+    bool may_idle;  // no writes, and ends in a branch or jump that may lead back to its start
+    DecodedOp ops[BLOCK_MAX_OPS];
+} Block;
+
+struct C6502BlockCache {
+    uint64_t deadline;  // total_cycles at which the current run is over
+#ifdef C6502_JIT_SUPPORTED
+    uint8_t *code;
+    size_t code_used;
+#endif
+    Block blocks[BLOCK_CACHE_SIZE];
+};
+
+
+/** true for instructions that write PC */
+static bool ends_block(const Op *const op) {
+    return (AM_REL == op->address_mode_handler) || (OP_JMP == op->op_handler) || (OP_JSR == op->op_handler) ||
+           (OP_RTS == op->op_handler) || (OP_RTI == op->op_handler) || (OP_BRK == op->op_handler) ||
+           (OP_JAM == op->op_handler);
+}
+
+/** true for instructions that change nothing but registers, reading at most a fixed address */
+static bool polls(const Op *const op) {
+    static void (*const read_only[])(C6502 *, const Op *) = {
+        OP_LDA, OP_LDX, OP_LDY, OP_LAX, OP_BIT, OP_CMP, OP_CPX, OP_CPY, OP_AND, OP_ORA, OP_EOR, OP_ADC, OP_SBC,
+        OP_NOP, OP_CLC, OP_SEC, OP_CLV, OP_CLD, OP_SED, OP_TAX, OP_TAY, OP_TXA, OP_TYA, OP_TSX, OP_BCC, OP_BCS,
+        OP_BEQ, OP_BMI, OP_BNE, OP_BPL, OP_BVC, OP_BVS, OP_JMP, OP_JAM,
+    };
+    const typeof(op->address_mode_handler) am = op->address_mode_handler;
+    if ((AM_IMP != am) && (AM_IMM != am) && (AM_ZP != am) && (AM_ABS != am) && (AM_REL != am)) {
+        return false;  // indexed and indirect reads depend on memory or registers changing within the loop
+    }
+    for (size_t i = 0; i < (sizeof(read_only) / sizeof(read_only[0])); i++) {
+        if (read_only[i] == op->op_handler) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** same as op->address_mode_handler(), with the predecoded operand instead of reading it from the bus. PC is already
+ * past the opcode */
+inline static uint16_t decoded_address(C6502 *const c, const Op *const op, const uint16_t operand) {
+    const typeof(op->address_mode_handler) am = op->address_mode_handler;
+    c->PC += op_length(op) - 1;
+    if (AM_IMM == am) {
+        return c->PC - 1;
+    } else if (AM_ZP == am) {
+        return operand;
+    } else if (AM_ZPX == am) {
+        return 0xFF & (c->X + operand);
+    } else if (AM_ZPY == am) {
+        return 0xFF & (c->Y + operand);
+    } else if (AM_REL == am) {
+        return c->PC + (int8_t)operand;
+    } else if (AM_ABS == am) {
+        return operand;
+    } else if (AM_ABX == am) {
+        return indexed(c, op, operand, c->X);
+    } else if (AM_ABY == am) {
+        return indexed(c, op, operand, c->Y);
+    } else if (AM_IND == am) {
+        return indirect(c, operand);
+    } else if (AM_INX == am) {
+        return zp_indirect(c, operand + c->X);
+    } else if (AM_INY == am) {
+        return indexed(c, op, zp_indirect(c, operand), c->Y);
+    }
+    return 0;  // implied, accumulator
+}
+
+/** runs one predecoded instruction, returns true when the block has to stop. That includes after a write through the
+ * bus interface, e.g. to a mapper register: the rest of the block may have been switched out */
+#define DECODED_OP(n)                                                                       \
+    __attribute__((flatten)) static bool decoded_op_##n(C6502 *const c, uint16_t operand) { \
+        const Op *const op = &optable[n];                                                   \
+        const uint64_t bus_writes = c->bus_writes;                                          \
+        PROFILE_START(c->PC);                                                               \
+        c->total_cycles++;                                                                  \
+        c->PC++; /* opcode */                                                               \
+        c->current_op_cycles_remaining = op->cycles;                                        \
+        c->addr = decoded_address(c, op, operand);                                          \
+        op->op_handler(c, op);                                                              \
+        PROFILE_OP(n);                                                                      \
+        FINISH_OP();                                                                        \
+        return (c->total_cycles >= c->block_cache->deadline) || c->nmi || c->irq ||         \
+               (c->bus_writes != bus_writes);                                               \
+    }
+#define DECODED_OPS(hi) FOR_EACH_OPCODE(DECODED_OP, hi)
+#define DECODED_OP_ENTRY(n) [n] = decoded_op_##n,
+#define DECODED_OP_ENTRIES(hi) FOR_EACH_OPCODE(DECODED_OP_ENTRY, hi)
+
+FOR_EACH_NIBBLE(DECODED_OPS)
+
+static bool (*const decoded_ops[0x100])(C6502 *, uint16_t operand) = {FOR_EACH_NIBBLE(DECODED_OP_ENTRIES)};
+
+#ifdef C6502_JIT_SUPPORTED
+
+/** true for instructions that only change registers, in a fixed number of cycles. Nothing else can tell when they ran,
+ * so the jit counts the cycles of a run of them once, at its end */
+static bool register_only(const Op *const op) {
+    const typeof(op->address_mode_handler) am = op->address_mode_handler;
+    return ((AM_IMP == am) || (AM_ACC == am) || (AM_IMM == am)) && !ends_block(op) &&
+           (OP_PHA != op->op_handler) && (OP_PHP != op->op_handler) && (OP_PLA != op->op_handler) &&
+           (OP_PLP != op->op_handler);
+}
+
+/** runs one predecoded register_only() instruction, leaving the cycles and the checks to the jit's code around it */
+#define FOLDED_OP(n)                                                                        \
+    __attribute__((flatten)) static void folded_op_##n(C6502 *const c, uint16_t operand) { \
+        const Op *const op = &optable[n];                                                  \
+        c->PC++; /* opcode */                                                              \
+        c->current_op_cycles_remaining = op->cycles;                                       \
+        c->addr = decoded_address(c, op, operand);                                         \
+        op->op_handler(c, op);                                                             \
+        c->current_op_cycles_remaining = 0;                                                \
+    }
+#define FOLDED_OPS(hi) FOR_EACH_OPCODE(FOLDED_OP, hi)
+#define FOLDED_OP_ENTRY(n) [n] = folded_op_##n,
+#define FOLDED_OP_ENTRIES(hi) FOR_EACH_OPCODE(FOLDED_OP_ENTRY, hi)
+
+FOR_EACH_NIBBLE(FOLDED_OPS)
+
+static void (*const folded_ops[0x100])(C6502 *, uint16_t operand) = {FOR_EACH_NIBBLE(FOLDED_OP_ENTRIES)};
+
+#endif
+
+/** predecodes the block starting at page[offset]. It's empty if not even its first instruction fits the page */
+static void decode_block(Block *const block, const uint8_t *const page, size_t offset) {
+    block->count = 0;
+    block->may_idle = true;
+    while (block->count < BLOCK_MAX_OPS) {
+        const Op *const op = &optable[page[offset]];
+        const int length = op_length(op);
+        if ((offset + length) > C6502_PAGE_SIZE) {
+            break;  // operand is in the next page, which may be switched separately
+        }
+        DecodedOp *const decoded = &block->ops[block->count++];
+        decoded->run = decoded_ops[page[offset]];
+        decoded->operand = (length > 1 ? page[offset + 1] : 0) | (length > 2 ? (page[offset + 2] << 8) : 0);
+        decoded->opcode = page[offset];
+        block->may_idle = block->may_idle && polls(op);
+        offset += length;
+        if (ends_block(op)) {
+            return;
+        }
+    }
+    block->may_idle = false;  // falls through into the next block
+}
+
+#ifdef C6502_JIT_SUPPORTED
+
+inline static uint8_t *emit(uint8_t *out, const void *const bytes, const size_t n) {
+    memcpy(out, bytes, n);
+    return out + n;
+}
+
+/** translates a decoded block into a function calling its handlers in turn, until one says stop. A run of
+ * register_only() instructions is called without checks in between, and its cycles are added at its end: it's only
+ * entered if it ends before the deadline, otherwise the function returns there */
+static void translate_block(struct C6502BlockCache *const cache, Block *const block) {
+    const size_t max_code = JIT_BLOCK_CODE_OVERHEAD + BLOCK_MAX_OPS * JIT_MAX_OP_CODE;
+    if ((JIT_CODE_SIZE - cache->code_used) < max_code) {
+        cache->code_used = 0;  // full, start over. find_block() translates the blocks again as they're hit
+        for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) {
+            cache->blocks[i].native = NULL;
+        }
+    }
+    uint8_t *const start = &cache->code[cache->code_used];
+    // the code buffer is never writable and executable at once: the pages this block goes to are made writable while
+    // it's emitted, which leaves any blocks sharing them unusable until they're executable again right after
+    uint8_t *const pages = (uint8_t *)((uintptr_t)start & ~(uintptr_t)(JIT_PAGE_SIZE - 1));
+    const size_t pages_size = (((uintptr_t)start + max_code + JIT_PAGE_SIZE - 1) & ~(uintptr_t)(JIT_PAGE_SIZE - 1)) -
+                              (uintptr_t)pages;
+    if (0 != mprotect(pages, pages_size, PROT_READ | PROT_WRITE)) {
+        return;  // stays interpreted
+    }
+    uint8_t *out = start;
+    uint8_t *exits[BLOCK_MAX_OPS];
+    int exit_count = 0;
+    const int32_t total_cycles = offsetof(C6502, total_cycles);
+    const uint64_t deadline = (uintptr_t)&cache->deadline;
+
+    out = emit(out, (const uint8_t[]){0x53, 0x48, 0x89, 0xFB}, 4);  // push rbx; mov rbx, rdi
+    for (int i = 0; i < block->count;) {
+        int folded = 0;
+        int32_t cycles = 0;
+        while (((i + folded) < block->count) && register_only(&optable[block->ops[i + folded].opcode])) {
+            cycles += optable[block->ops[i + folded].opcode].cycles;
+            folded++;
+        }
+        if (folded >= JIT_MIN_FOLDED_OPS) {
+            out = emit(out, (const uint8_t[]){0x48, 0x8B, 0x83}, 3);  // mov rax, [rbx + disp32]
+            out = emit(out, &total_cycles, 4);
+            out = emit(out, (const uint8_t[]){0x48, 0x05}, 2);  // add rax, imm32
+            out = emit(out, &cycles, 4);
+            out = emit(out, (const uint8_t[]){0x48, 0xB9}, 2);  // mov rcx, imm64
+            out = emit(out, &deadline, 8);
+            out = emit(out, (const uint8_t[]){0x48, 0x3B, 0x01, 0x0F, 0x83}, 5);  // cmp rax, [rcx]; jae
+            exits[exit_count++] = out;
+            out += 4;
+            for (; folded > 0; folded--, i++) {
+                const uint32_t operand = block->ops[i].operand;
+                const uint64_t handler = (uintptr_t)folded_ops[block->ops[i].opcode];
+                out = emit(out, (const uint8_t[]){0x48, 0x89, 0xDF, 0xBE}, 4);  // mov rdi, rbx; mov esi, imm32
+                out = emit(out, &operand, 4);
+                out = emit(out, (const uint8_t[]){0x48, 0xB8}, 2);  // mov rax, imm64
+                out = emit(out, &handler, 8);
+                out = emit(out, (const uint8_t[]){0xFF, 0xD0}, 2);  // call rax
+            }
+            out = emit(out, (const uint8_t[]){0x48, 0x81, 0x83}, 3);  // add qword [rbx + disp32], imm32
+            out = emit(out, &total_cycles, 4);
+            out = emit(out, &cycles, 4);
+            continue;
+        }
+        const uint32_t operand = block->ops[i].operand;
+        const uint64_t handler = (uintptr_t)block->ops[i].run;
+        out = emit(out, (const uint8_t[]){0x48, 0x89, 0xDF, 0xBE}, 4);  // mov rdi, rbx; mov esi, imm32
+        out = emit(out, &operand, 4);
+        out = emit(out, (const uint8_t[]){0x48, 0xB8}, 2);  // mov rax, imm64
+        out = emit(out, &handler, 8);
+        out = emit(out, (const uint8_t[]){0xFF, 0xD0, 0x84, 0xC0, 0x0F, 0x85}, 6);  // call rax; test al, al; jnz
+        exits[exit_count++] = out;
+        out += 4;
+        i++;
+    }
+    out = emit(out, (const uint8_t[]){0x5B, 0xC3}, 2);  // pop rbx; ret
+    for (int i = 0; i < exit_count; i++) {
+        const int32_t rel = (out - 2) - (exits[i] + 4);
+        memcpy(exits[i], &rel, sizeof(rel));
+    }
+    cache->code_used += out - start;
+    if (0 != mprotect(pages, pages_size, PROT_READ | PROT_EXEC)) {
+        for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) {
+            cache->blocks[i].native = NULL;  // some of them may be in these pages
+        }
+        return;
+    }
+    block->native = (void (*)(C6502 *))start;
+}
+
+#endif
+
+/** cached block at PC, NULL if its code can't be cached */
+static const Block *find_block(C6502 *const c) {
+    const uint8_t *const page = c->read_pages[c->PC >> C6502_PAGE_BITS];
+    if ((NULL == page) || (NULL != c->write_pages[c->PC >> C6502_PAGE_BITS])) {
+        return NULL;  // i/o, or ram that could be written under the block
+    }
+    const size_t offset = c->PC & (C6502_PAGE_SIZE - 1);
+    const uint8_t *const key = &page[offset];
+    Block *const block = &c->block_cache->blocks[((uintptr_t)key ^ ((uintptr_t)key >> 12)) % BLOCK_CACHE_SIZE];
+    if (block->key == key) {
+        c->block_cache_stats.hits++;
+#ifdef C6502_JIT_SUPPORTED
+        if (c->block_cache->code && (NULL == block->native)) {
+            translate_block(c->block_cache, block);  // dropped when the code buffer filled up
+        }
+#endif
+        return block;
+    }
+    c->block_cache_stats.misses++;
+    decode_block(block, page, offset);
+    if (0 == block->count) {
+        block->key = NULL;
+        return NULL;
+    }
+    block->key = key;
+    block->native = NULL;
+#ifdef C6502_JIT_SUPPORTED
+    if (c->block_cache->code) {
+        translate_block(c->block_cache, block);
+    }
+#endif
+    return block;
+}
+
+static void run_block(C6502 *const c, const Block *const block) {
+    if (block->native) {
+        const uint64_t start = c->total_cycles;
+        block->native(c);
+        if (c->total_cycles != start) {
+            return;
+        }
+        // it starts with a run of instructions that would cross the deadline, see translate_block()
+    }
+    for (const DecodedOp *op = block->ops; op < &block->ops[block->count]; op++) {
+        if (op->run(c, op->operand)) {
+            return;
+        }
+    }
+}
+
+/** total_cycles before which every address the block reads keeps reading the same. 0 if some i/o could change */
+static uint64_t polled_until(const C6502 *const c, const Block *const block) {
+    uint64_t until = UINT64_MAX;
+    for (const DecodedOp *decoded = block->ops; decoded < &block->ops[block->count]; decoded++) {
+        const Op *const op = &optable[decoded->opcode];
+        if (((AM_ZP != op->address_mode_handler) && (AM_ABS != op->address_mode_handler)) ||
+            (OP_JMP == op->op_handler) || (OP_NOP == op->op_handler)) {
+            continue;  // no data read
+        }
+        if (c->read_pages[decoded->operand >> C6502_PAGE_BITS]) {
+            continue;  // memory, only the cpu changes it
+        }
+        if (NULL == c->bus_interface->stable_until) {
+            return 0;
+        }
+        const uint64_t stable_until = c->bus_interface->stable_until(c->bus_ctx, decoded->operand);
+        until = (stable_until < until) ? stable_until : until;
+    }
+    return until;
+}
+
+/** runs a block that may be an idle loop, e.g. `-: LDA $2002; BPL -`. If an iteration ends back at the start with the
+ * registers as they were, the following ones do the same for as long as what it polls reads the same (interrupts only
+ * come with the end of the run). Those iterations are skipped, landing on the cycle the last whole one before then
+ * would have ended on, and the rest runs as usual */
+static void run_idle_block(C6502 *const c, const Block *const block) {
+    const uint16_t pc = c->PC;
+    const uint8_t regs[] = {c->AC, c->X, c->Y, c->SP, status(c).u8};
+    const uint64_t start = c->total_cycles;
+    const uint64_t polled = polled_until(c, block);  // covers the reads of this iteration too
+    run_block(c, block);
+    if ((c->PC != pc) || (c->AC != regs[0]) || (c->X != regs[1]) || (c->Y != regs[2]) || (c->SP != regs[3]) ||
+        (status(c).u8 != regs[4]) || c->nmi || c->irq) {
+        return;  // not a loop, or one that's still doing something
+    }
+    const uint64_t period = c->total_cycles - start;
+    const uint64_t until = (polled < c->block_cache->deadline) ? polled : c->block_cache->deadline;
+    if (until > (c->total_cycles + period)) {  // all reads of a skipped iteration happen before until
+        const uint64_t skipped = ((until - 1 - c->total_cycles) / period) * period;
+        c->total_cycles += skipped;
+        c->block_cache_stats.idle_cycles += skipped;
+    }
+}
+
+static int64_t cached_run(C6502 *const c, const int64_t cycle_budget) {
+    const uint64_t start = c->total_cycles;
+    c->block_cache->deadline = start + cycle_budget;
     do {
-        ret++;
-        c6502_cycle(c);
-    } while (c->current_op_cycles_remaining);
-    return ret;
+        const Block *const block = (c->current_op_cycles_remaining || c->nmi || c->irq) ? NULL : find_block(c);
+        if (block && block->may_idle && c->skip_idle_loops) {
+            run_idle_block(c, block);
+        } else if (block) {
+            run_block(c, block);
+        } else {
+            step(c);  // stall, interrupt or code outside rom
+        }
+    } while ((c->total_cycles < c->block_cache->deadline) && !c->nmi && !c->irq);
+    return c->total_cycles - start;
+}
+
+bool c6502_block_cache_init(C6502 *const c) {
+    if ((NULL == c->read_pages) || (NULL == c->write_pages)) {
+        return false;
+    }
+    if (NULL == c->block_cache) {
+        struct C6502BlockCache *const cache = calloc(1, sizeof(*cache));
+        if (NULL == cache) {
+            return false;
+        }
+#ifdef C6502_JIT_SUPPORTED
+        // not executable yet, translate_block() flips the pages it emits to
+        cache->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == cache->code) {
+            cache->code = NULL;  // interpret the blocks
+        }
+#endif
+        c->block_cache = cache;
+    }
+    memset(c->block_cache->blocks, 0, sizeof(c->block_cache->blocks));
+#ifdef C6502_JIT_SUPPORTED
+    c->block_cache->code_used = 0;
+#endif
+    c->block_cache_stats.hits = 0;
+    c->block_cache_stats.misses = 0;
+    c->block_cache_stats.idle_cycles = 0;
+    return true;
+}
+
+void c6502_block_cache_deinit(C6502 *const c) {
+    if (c->block_cache) {
+#ifdef C6502_JIT_SUPPORTED
+        if (c->block_cache->code) {
+            munmap(c->block_cache->code, JIT_CODE_SIZE);
+        }
+#endif
+        free(c->block_cache);
+        c->block_cache = NULL;
+    }
+}
+
+int c6502_run_next_instruction(C6502 *const c) {
+    return step(c);
 }
 
 void c6502_reset(C6502 *const c) {
     c->addr = RESET_ADDR;
     c->PC = read_u16(c, c->addr);
     c->SP = RESET_SP;
-    c->SR.u8 = 0;
-    c->SR._unused = 1;
+    set_status(c, STATUS_UNUSED);
     c->AC = 0;
     c->X = 0;
     c->Y = 0;
@@ -913,10 +1662,275 @@ void c6502_reset(C6502 *const c) {
 }
 
 void c6502_irq(C6502 *c) {
-    if (0 == c->SR.I) {
+    if (0 == (c->flags.other & STATUS_I)) {
         c->irq = true;
     }
 }
 void c6502_nmi(C6502 *c) {
     c->nmi = true;
 }
+
+C6502Status c6502_status(const C6502 *const c) {
+    return status(c);
+}
+
+void c6502_set_status(C6502 *const c, const uint8_t sr) {
+    set_status(c, sr);
+}
+
+static const struct {
+    void (*handler)(C6502 *, const Op *);
+    const char *name;
+} OP_NAMES[] = {
+    {OP_ADC, "ADC"}, {OP_AND, "AND"}, {OP_ASL, "ASL"}, {OP_BCC, "BCC"}, {OP_BCS, "BCS"}, {OP_BEQ, "BEQ"},
+    {OP_BIT, "BIT"}, {OP_BMI, "BMI"}, {OP_BNE, "BNE"}, {OP_BPL, "BPL"}, {OP_BRK, "BRK"}, {OP_BVC, "BVC"},
+    {OP_BVS, "BVS"}, {OP_CLC, "CLC"}, {OP_CLD, "CLD"}, {OP_CLI, "CLI"}, {OP_CLV, "CLV"}, {OP_CMP, "CMP"},
+    {OP_CPX, "CPX"}, {OP_CPY, "CPY"}, {OP_DEC, "DEC"}, {OP_DEX, "DEX"}, {OP_DEY, "DEY"}, {OP_EOR, "EOR"},
+    {OP_INC, "INC"}, {OP_INX, "INX"}, {OP_INY, "INY"}, {OP_JMP, "JMP"}, {OP_JSR, "JSR"}, {OP_LDA, "LDA"},
+    {OP_LDX, "LDX"}, {OP_LDY, "LDY"}, {OP_LSR, "LSR"}, {OP_NOP, "NOP"}, {OP_ORA, "ORA"}, {OP_PHA, "PHA"},
+    {OP_PHP, "PHP"}, {OP_PLA, "PLA"}, {OP_PLP, "PLP"}, {OP_ROL, "ROL"}, {OP_ROR, "ROR"}, {OP_RTI, "RTI"},
+    {OP_RTS, "RTS"}, {OP_SBC, "SBC"}, {OP_SEC, "SEC"}, {OP_SED, "SED"}, {OP_SEI, "SEI"}, {OP_STA, "STA"},
+    {OP_STX, "STX"}, {OP_STY, "STY"}, {OP_TAX, "TAX"}, {OP_TAY, "TAY"}, {OP_TSX, "TSX"}, {OP_TXA, "TXA"},
+    {OP_TXS, "TXS"}, {OP_TYA, "TYA"}, {OP_LAX, "LAX"}, {OP_SAX, "SAX"}, {OP_DCP, "DCP"}, {OP_ISC, "ISB"},
+    {OP_SLO, "SLO"}, {OP_RLA, "RLA"}, {OP_SRE, "SRE"}, {OP_RRA, "RRA"}, {OP_ANC, "ANC"}, {OP_ALR, "ALR"},
+    {OP_ARR, "ARR"}, {OP_AXS, "AXS"}, {OP_LAS, "LAS"}, {OP_SHA, "SHA"},
+    {OP_TAS, "TAS"}, {OP_SHY, "SHY"}, {OP_SHX, "SHX"}, {OP_JAM, "JAM"},
+};
+
+static const char *op_name(const Op *const op) {
+    for (size_t i = 0; i < sizeof(OP_NAMES) / sizeof(OP_NAMES[0]); i++) {
+        if (OP_NAMES[i].handler == op->op_handler) {
+            return OP_NAMES[i].name;
+        }
+    }
+    return "???";
+}
+
+#ifdef C6502_PROFILE
+
+static const struct {
+    uint16_t (*handler)(C6502 *, const Op *);
+    const char *name;
+} MODE_NAMES[] = {
+    {AM_ACC, "acc"}, {AM_IMP, "imp"}, {AM_IMM, "imm"}, {AM_ZP, "zp"}, {AM_ZPX, "zpx"}, {AM_ZPY, "zpy"},
+    {AM_REL, "rel"}, {AM_ABS, "abs"}, {AM_ABX, "abx"}, {AM_ABY, "aby"}, {AM_IND, "ind"}, {AM_INX, "inx"},
+    {AM_INY, "iny"},
+};
+#define MODES (sizeof(MODE_NAMES) / sizeof(MODE_NAMES[0]))
+
+static size_t mode_index(const Op *const op) {
+    for (size_t i = 0; i < MODES; i++) {
+        if (MODE_NAMES[i].handler == op->address_mode_handler) {
+            return i;
+        }
+    }
+    return MODES;
+}
+
+/** offset of code into rom, -1 if it isn't in there */
+static int64_t rom_offset(const uint8_t *const code, const uint8_t *const rom, const size_t rom_size) {
+    if ((NULL == code) || (NULL == rom) || (code < rom) || (code >= rom + rom_size)) {
+        return -1;
+    }
+    return code - rom;
+}
+
+static int hotter(const void *const a, const void *const b) {
+    const ProfilePc *const x = *(const ProfilePc *const *)a;
+    const ProfilePc *const y = *(const ProfilePc *const *)b;
+    return (x->counts.cycles < y->counts.cycles) - (x->counts.cycles > y->counts.cycles);
+}
+
+bool c6502_profile_init(C6502 *const c) {
+    if (NULL == c->profile) {
+        c->profile = malloc(sizeof(*c->profile));
+        if (NULL == c->profile) {
+            return false;
+        }
+    }
+    memset(c->profile, 0, sizeof(*c->profile));
+    return true;
+}
+
+void c6502_profile_deinit(C6502 *const c) {
+    free(c->profile);
+    c->profile = NULL;
+}
+
+void c6502_profile_dump(const C6502 *const c, FILE *const f, const C6502ProfileFormat format, const uint8_t *const rom,
+                        const size_t rom_size) {
+    const struct C6502Profile *const p = c->profile;
+    if (NULL == p) {
+        return;
+    }
+    const bool json = (C6502_PROFILE_JSON == format);
+    ProfileCounts modes[MODES + 1] = {0};
+    for (int opcode = 0; opcode < 0x100; opcode++) {
+        const ProfileCounts *const counts = &p->opcodes[opcode];
+        ProfileCounts *const mode = &modes[mode_index(&optable[opcode])];
+        mode->count += counts->count;
+        mode->cycles += counts->cycles;
+        mode->page_crossings += counts->page_crossings;
+    }
+
+    size_t used = 0;
+    const ProfilePc **const pcs = malloc(PROFILE_PCS * sizeof(*pcs));
+    if (pcs) {
+        for (size_t i = 0; i < PROFILE_PCS; i++) {
+            if (p->pcs[i].used) {
+                pcs[used++] = &p->pcs[i];
+            }
+        }
+        qsort(pcs, used, sizeof(*pcs), hotter);
+    }
+
+    // one csv table, kind says which columns apply
+    const char *sep = "";
+    if (json) {
+        fprintf(f, "{\n  \"opcodes\": [");
+    } else {
+        fprintf(f, "kind,opcode,mnemonic,mode,pc,rom_offset,count,cycles,page_crossings\n");
+    }
+    for (int opcode = 0; opcode < 0x100; opcode++) {
+        const ProfileCounts *const counts = &p->opcodes[opcode];
+        const Op *const op = &optable[opcode];
+        const size_t mode = mode_index(op);
+        const char *const mode_name = (mode < MODES) ? MODE_NAMES[mode].name : "";
+        if (0 == counts->count) {
+            continue;
+        }
+        if (json) {
+            fprintf(f,
+                    "%s\n    {\"opcode\": %d, \"mnemonic\": \"%s\", \"mode\": \"%s\", \"count\": %llu, "
+                    "\"cycles\": %llu, \"page_crossings\": %llu}",
+                    sep, opcode, op_name(op), mode_name, (unsigned long long)counts->count,
+                    (unsigned long long)counts->cycles, (unsigned long long)counts->page_crossings);
+        } else {
+            fprintf(f, "opcode,$%02X,%s,%s,,,%llu,%llu,%llu\n", opcode, op_name(op), mode_name,
+                    (unsigned long long)counts->count, (unsigned long long)counts->cycles,
+                    (unsigned long long)counts->page_crossings);
+        }
+        sep = ",";
+    }
+
+    sep = "";
+    if (json) {
+        fprintf(f, "\n  ],\n  \"modes\": [");
+    }
+    for (size_t mode = 0; mode < MODES; mode++) {
+        const ProfileCounts *const counts = &modes[mode];
+        if (0 == counts->count) {
+            continue;
+        }
+        if (json) {
+            fprintf(f,
+                    "%s\n    {\"mode\": \"%s\", \"count\": %llu, \"cycles\": %llu, \"page_crossings\": %llu}",
+                    sep, MODE_NAMES[mode].name, (unsigned long long)counts->count,
+                    (unsigned long long)counts->cycles, (unsigned long long)counts->page_crossings);
+        } else {
+            fprintf(f, "mode,,,%s,,,%llu,%llu,%llu\n", MODE_NAMES[mode].name, (unsigned long long)counts->count,
+                    (unsigned long long)counts->cycles, (unsigned long long)counts->page_crossings);
+        }
+        sep = ",";
+    }
+
+    sep = "";
+    if (json) {
+        fprintf(f, "\n  ],\n  \"pcs\": [");
+    }
+    for (size_t i = 0; i < used; i++) {
+        const ProfilePc *const entry = pcs[i];
+        const int64_t offset = rom_offset(entry->code, rom, rom_size);
+        char offset_text[24] = "";
+        if (offset >= 0) {
+            snprintf(offset_text, sizeof(offset_text), "%lld", (long long)offset);
+        }
+        if (json) {
+            fprintf(f,
+                    "%s\n    {\"pc\": %u, \"rom_offset\": %s, \"opcode\": %u, \"count\": %llu, \"cycles\": %llu, "
+                    "\"page_crossings\": %llu}",
+                    sep, entry->pc, (offset >= 0) ? offset_text : "null", entry->opcode,
+                    (unsigned long long)entry->counts.count, (unsigned long long)entry->counts.cycles,
+                    (unsigned long long)entry->counts.page_crossings);
+        } else {
+            fprintf(f, "pc,$%02X,%s,,$%04X,%s,%llu,%llu,%llu\n", entry->opcode, op_name(&optable[entry->opcode]),
+                    entry->pc, offset_text, (unsigned long long)entry->counts.count,
+                    (unsigned long long)entry->counts.cycles, (unsigned long long)entry->counts.page_crossings);
+        }
+        sep = ",";
+    }
+    if (json) {
+        fprintf(f, "\n  ],\n  \"pcs_dropped\": %llu\n}\n", (unsigned long long)p->pcs_dropped);
+    }
+    free(pcs);
+}
+
+#else
+
+bool c6502_profile_init(C6502 *) {
+    return false;
+}
+
+void c6502_profile_deinit(C6502 *) {}
+
+void c6502_profile_dump(const C6502 *, FILE *, C6502ProfileFormat, const uint8_t *, size_t) {}
+
+#endif
+
+C6502Trace *c6502_trace_init(C6502 *const c, void *const buf, const size_t size) {
+    if (size < sizeof(C6502Trace) + sizeof(C6502TraceRecord)) {
+        return NULL;
+    }
+    C6502Trace *const t = buf;
+    memcpy(t->magic, C6502_TRACE_MAGIC, sizeof(t->magic));
+    t->capacity = (size - sizeof(C6502Trace)) / sizeof(C6502TraceRecord);
+    t->written = 0;
+    c->trace = t;
+    return t;
+}
+
+void c6502_trace_deinit(C6502 *const c) {
+    c->trace = NULL;
+}
+
+int c6502_trace_format(const C6502TraceRecord *const r, char *const out, const size_t size) {
+    const Op *const op = &optable[r->bytes[0]];
+    const uint8_t zp = r->bytes[1];
+    const uint16_t abs = r->bytes[1] | (r->bytes[2] << 8);
+    char bytes[12] = "";
+    for (int i = 0, n = 0; i < r->length; i++) {
+        n += snprintf(&bytes[n], sizeof(bytes) - n, i ? " %02X" : "%02X", r->bytes[i]);
+    }
+    uint16_t (*const mode)(C6502 *, const Op *) = op->address_mode_handler;
+    char operand[12] = "";
+    if (AM_ACC == mode) {
+        snprintf(operand, sizeof(operand), " A");
+    } else if (AM_IMM == mode) {
+        snprintf(operand, sizeof(operand), " #$%02X", zp);
+    } else if (AM_ZP == mode) {
+        snprintf(operand, sizeof(operand), " $%02X", zp);
+    } else if (AM_ZPX == mode) {
+        snprintf(operand, sizeof(operand), " $%02X,X", zp);
+    } else if (AM_ZPY == mode) {
+        snprintf(operand, sizeof(operand), " $%02X,Y", zp);
+    } else if (AM_REL == mode) {
+        snprintf(operand, sizeof(operand), " $%04X", (uint16_t)(r->pc + 2 + (int8_t)zp));
+    } else if (AM_ABS == mode) {
+        snprintf(operand, sizeof(operand), " $%04X", abs);
+    } else if (AM_ABX == mode) {
+        snprintf(operand, sizeof(operand), " $%04X,X", abs);
+    } else if (AM_ABY == mode) {
+        snprintf(operand, sizeof(operand), " $%04X,Y", abs);
+    } else if (AM_IND == mode) {
+        snprintf(operand, sizeof(operand), " ($%04X)", abs);
+    } else if (AM_INX == mode) {
+        snprintf(operand, sizeof(operand), " ($%02X,X)", zp);
+    } else if (AM_INY == mode) {
+        snprintf(operand, sizeof(operand), " ($%02X),Y", zp);
+    }
+    char instruction[20];
+    snprintf(instruction, sizeof(instruction), "%s%s", op_name(op), operand);
+    return snprintf(out, size, "%04X  %-8s  %-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu", r->pc,
+                    bytes, instruction, r->a, r->x, r->y, r->p, r->sp, r->scanline, r->dot,
+                    (unsigned long long)r->cycle);
+}
@@ -2,49 +2,152 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+
+#define C6502_PAGE_BITS 10  // 1KB
+#define C6502_PAGE_SIZE (1 << C6502_PAGE_BITS)
+
+typedef union __attribute__((__packed__)) {
+    uint8_t u8;  // status register
+    struct __attribute__((__packed__)) {
+        uint8_t C : 1;        // carry bit
+        uint8_t Z : 1;        // zero
+        uint8_t I : 1;        // disable interrupts
+        uint8_t D : 1;        // decimal mode ToDo
+        uint8_t B : 1;        // break
+        uint8_t _unused : 1;  // unused
+        uint8_t V : 1;        // overflow
+        uint8_t N : 1;        // negative
+    };
+} C6502Status;
 
 typedef struct {
     uint8_t (*read)(void *bus_ctx, uint16_t addr);
     bool (*write)(void *bus_ctx, uint16_t addr, uint8_t val);
+    // optional, lets c6502_run() skip idle loops polling i/o: the total_cycles before which reads of addr from now on
+    // all return the same, and repeating one has no further side effects. 0 if it can't tell
+    uint64_t (*stable_until)(void *bus_ctx, uint16_t addr);
+    // optional, for the trace: where the video chip is at the given total_cycles, e.g. the ppu's scanline and dot
+    void (*trace_position)(void *bus_ctx, uint64_t cycle, int16_t *scanline, int16_t *dot);
 } C6502BusInterface;
 
+/** one instruction in the trace, as it was about to run */
+typedef struct {
+    uint64_t cycle;    // total_cycles
+    uint16_t pc;
+    int16_t scanline;  // from bus_interface->trace_position, 0 without
+    int16_t dot;
+    uint8_t bytes[3];  // the instruction, 0 past its length
+    uint8_t length;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t p;
+    uint8_t sp;
+    uint8_t reserved;
+} C6502TraceRecord;
+
+#define C6502_TRACE_MAGIC "c6502tr"
+
+/** ring buffer of the last capacity instructions, laid out the same in memory and in a file */
+typedef struct {
+    char magic[8];      // C6502_TRACE_MAGIC
+    uint64_t capacity;  // records
+    uint64_t written;   // records so far, the oldest one kept is at written % capacity once it wrapped
+    C6502TraceRecord records[];
+} C6502Trace;
+
 typedef struct {
     void *bus_ctx;
     const C6502BusInterface *bus_interface;
 
+    // optional view of the bus as C6502_PAGE_SIZE pages of host memory, e.g. a cart's page table with the console's
+    // ram in it. The cpu loads and stores mapped pages directly, NULL entries are only reachable through bus_interface
+    const uint8_t *const *read_pages;
+    uint8_t *const *write_pages;
+
+    // c6502_run() fast-forwards cached loops that poll memory without changing anything, until the end of the run or
+    // until what they poll could change. Memory in read_pages is assumed to only change through the cpu's own writes
+    bool skip_idle_loops;
+
     // Private
 
-    uint8_t AC;                           // accumulator
-    uint8_t X;                            // register
-    uint8_t Y;                            // register
-    uint8_t SP;                           // stack pointer
-    uint16_t PC;                          // program counter
-    uint16_t addr;                        // current target address on bus
-    uint8_t current_op_cycles_remaining;  // cycles left on current op
-    uint32_t total_cycles;
-
-    union __attribute__((__packed__)) {
-        uint8_t u8;  // status register
-        struct __attribute__((__packed__)) {
-            uint8_t C : 1;        // carry bit
-            uint8_t Z : 1;        // zero
-            uint8_t I : 1;        // disable interrupts
-            uint8_t D : 1;        // decimal mode ToDo
-            uint8_t B : 1;        // break
-            uint8_t _unused : 1;  // unused
-            uint8_t V : 1;        // overflow
-            uint8_t N : 1;        // negative
-        };
-    } SR;
+    uint8_t AC;                            // accumulator
+    uint8_t X;                             // register
+    uint8_t Y;                             // register
+    uint8_t SP;                            // stack pointer
+    uint16_t PC;                           // program counter
+    uint16_t addr;                         // current target address on bus
+    uint16_t current_op_cycles_remaining;  // cycles left on current op (incl. DMA stalls)
+    uint64_t total_cycles;
+    uint64_t bus_writes;  // writes that went through bus_interface, which may have switched banks
+
+    // status register, kept as separate bytes that instructions store without touching the others, and put together
+    // by c6502_status() when it's needed
+    struct {
+        uint8_t n;      // N is bit 7 of the last result
+        uint8_t z;      // 0 or 1
+        uint8_t c;      // 0 or 1
+        uint8_t v;      // 0 or 1
+        uint8_t other;  // I, D, B and the unused bit, in place
+    } flags;
 
     bool irq;  // irq triggered and yet to be serviced
     bool nmi;  // nmi triggered and yet to be serviced
+
+    struct C6502BlockCache *block_cache;  // see c6502_block_cache_init(). NULL until then
+    struct {
+        uint64_t hits;
+        uint64_t misses;       // blocks (re)decoded
+        uint64_t idle_cycles;  // skipped in idle loops
+    } block_cache_stats;
+
+    struct C6502Profile *profile;  // see c6502_profile_init(). NULL until then
+    C6502Trace *trace;             // see c6502_trace_init(). NULL until then
 } C6502;
 
 void c6502_reset(C6502 *);
 void c6502_irq(C6502 *);
 void c6502_nmi(C6502 *);
 
-void c6502_cycle(C6502 *);
+/** the status register (P) */
+C6502Status c6502_status(const C6502 *);
+void c6502_set_status(C6502 *, uint8_t status);
+
+/** Executes whole instructions back to back until at least cycle_budget cycles have been used, or an interrupt is
+ * pending. The last instruction may overrun the budget. Returns the number of cycles actually run. */
+int64_t c6502_run(C6502 *, int64_t cycle_budget);
 
+/** Executes one instruction (or pending stall) and returns the number of cycles it took */
 int c6502_run_next_instruction(C6502 *);
+
+/** Has c6502_run() cache the code in read-only pages (a read page but no write page, e.g. prg-rom) as predecoded
+ * blocks, which run without fetching and dispatching each instruction over the bus. Blocks are also translated to
+ * x86-64 if built with C6502_JIT on such a host. Needs read_pages and write_pages, which may be remapped at any time.
+ * Can be called again to drop all blocks. Returns false without page tables, or if out of memory. */
+bool c6502_block_cache_init(C6502 *);
+void c6502_block_cache_deinit(C6502 *);
+
+typedef enum { C6502_PROFILE_CSV, C6502_PROFILE_JSON } C6502ProfileFormat;
+
+/** Starts counting executions, cycles and page crossing penalties per opcode, per addressing mode and per pc. Only
+ * available when built with C6502_PROFILE, which adds a call per instruction; without it there is no cost and this
+ * returns false. Cycles fast-forwarded in idle loops only show in block_cache_stats.idle_cycles. Can be called again
+ * to start over. Returns false if out of memory. */
+bool c6502_profile_init(C6502 *);
+void c6502_profile_deinit(C6502 *);
+
+/** Writes the counts so far, hottest pc first. Code read from within rom (e.g. a cart's prg-rom) is reported with its
+ * offset into it, which tells the bank; rom may be NULL. Does nothing if not profiling. */
+void c6502_profile_dump(const C6502 *, FILE *, C6502ProfileFormat, const uint8_t *rom, size_t rom_size);
+
+/** Starts recording every instruction into a C6502Trace laid out in buf, e.g. malloc()'ed, or a mmap()'ed file that
+ * is still there after a crash. While tracing, c6502_run() goes one instruction at a time instead of the fused or
+ * cached paths, which is slower but fast enough to leave on. Returns NULL if buf has no room for a record. */
+C6502Trace *c6502_trace_init(C6502 *, void *buf, size_t size);
+/** stops recording, buf is left as it is */
+void c6502_trace_deinit(C6502 *);
+
+/** a nestest.log style line for the record, e.g. "C000  4C F5 C5  JMP $C5F5  A:00 ..." without the values of memory
+ * operands. Returns what snprintf() does */
+int c6502_trace_format(const C6502TraceRecord *, char *out, size_t size);
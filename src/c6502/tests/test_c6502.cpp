@@ -35,6 +35,20 @@ void expect_write(uint16_t addr, uint8_t val, bool ret) {
 
 TEST_GROUP(C6502TestGroup) {
     C6502 c;
+    uint8_t ram[C6502_PAGE_SIZE];
+    const uint8_t *read_pages[0x10000 >> C6502_PAGE_BITS];
+    uint8_t *write_pages[0x10000 >> C6502_PAGE_BITS];
+
+    /** maps ram at $0000, zero page and stack, so only the rest goes through the bus */
+    void map_ram() {
+        memset(ram, 0, sizeof(ram));
+        memset(read_pages, 0, sizeof(read_pages));
+        memset(write_pages, 0, sizeof(write_pages));
+        read_pages[0] = ram;
+        write_pages[0] = ram;
+        c.read_pages = read_pages;
+        c.write_pages = write_pages;
+    }
 
     TEST_SETUP() {
         memset(&c, 0, sizeof(c));
@@ -58,9 +72,388 @@ TEST(C6502TestGroup, test_reset) {
     // Todo - check rest of reset stuff
 }
 
+TEST(C6502TestGroup, test_run_budget) {
+    c.PC = 100;
+    c.current_op_cycles_remaining = 7;  // e.g. after reset
+    mock_bus::expect_read(100, 0xEA);   // NOP
+    mock_bus::expect_read(101, 0xEA);
+    CHECK_EQUAL(11, c6502_run(&c, 10));  // last instruction overruns
+    CHECK_EQUAL(11, c.total_cycles);
+    CHECK_EQUAL(102, c.PC);
+    CHECK_EQUAL(0, c6502_run(&c, 0));
+}
+
+TEST(C6502TestGroup, test_run_stops_for_interrupt) {
+    c.PC = 100;
+    c.SP = 0xFD;
+    c.nmi = true;
+    mock_bus::expect_write(0x1FD, 0, true);  // push PC and SR
+    mock_bus::expect_write(0x1FC, 100, true);
+    mock_bus::expect_write(0x1FB, 0, true);
+    mock_bus::expect_read(0xFFFA, 0x00);
+    mock_bus::expect_read(0xFFFB, 0x80);
+    mock_bus::expect_read(0x8000, 0xEA);
+    CHECK_EQUAL(9, c6502_run(&c, 9));
+    CHECK_EQUAL(0x8001, c.PC);
+
+    c.nmi = true;  // raised mid-slice, e.g. by the ppu
+    CHECK_EQUAL(0, c6502_run(&c, 0));
+    CHECK(c.nmi);
+}
+
+TEST(C6502TestGroup, test_mapped_pages_skip_bus) {
+    map_ram();
+    c.PC = 0x8000;
+    c.SP = 0xFD;
+    ram[0x10] = 0x34;
+    ram[0x11] = 0x12;
+
+    mock_bus::expect_read(0x8000, 0xB1);  // LDA ($10),Y: only the code and the data at $1234 are off the page
+    mock_bus::expect_read(0x8001, 0x10);
+    mock_bus::expect_read(0x1234, 0x56);
+    CHECK_EQUAL(5, c6502_run_next_instruction(&c));
+    mock_bus::expect_read(0x8002, 0x48);  // PHA
+    CHECK_EQUAL(3, c6502_run_next_instruction(&c));
+    CHECK_EQUAL(0x56, ram[0x1FD]);
+    CHECK_EQUAL(0xFC, c.SP);
+}
+
+TEST(C6502TestGroup, test_profile) {
+#ifdef C6502_PROFILE
+    map_ram();
+    c.PC = 0x00F0;
+    const uint8_t code[] = {0xBD, 0xFF, 0x00, 0xBD, 0x00, 0x00};  // LDA $00FF,X crossing a page, then not
+    memcpy(&ram[0xF0], code, sizeof(code));
+    c.X = 1;
+    CHECK(c6502_profile_init(&c));
+
+    CHECK_EQUAL(5, c6502_run_next_instruction(&c));
+    CHECK_EQUAL(4, c6502_run_next_instruction(&c));
+    char *text = NULL;
+    size_t size = 0;
+    FILE *f = open_memstream(&text, &size);
+    c6502_profile_dump(&c, f, C6502_PROFILE_CSV, ram, sizeof(ram));
+    fclose(f);
+    STRCMP_CONTAINS("opcode,$BD,LDA,abx,,,2,9,1\n", text);
+    STRCMP_CONTAINS("mode,,,abx,,,2,9,1\n", text);
+    STRCMP_CONTAINS("pc,$BD,LDA,,$00F0,240,1,5,1\n", text);
+    free(text);
+    c6502_profile_deinit(&c);
+#else
+    CHECK_FALSE(c6502_profile_init(&c));
+#endif
+}
+
+TEST(C6502TestGroup, test_trace_ring) {
+    map_ram();
+    c.PC = 0x0200;
+    c.SP = 0xFD;
+    c6502_set_status(&c, 0x24);
+    const uint8_t code[] = {0xA9, 0x12, 0xAA, 0x4C, 0x00, 0x02};  // LDA #$12; TAX; JMP $0200
+    memcpy(&ram[0x200], code, sizeof(code));
+    static uint64_t buf[(sizeof(C6502Trace) + 2 * sizeof(C6502TraceRecord)) / sizeof(uint64_t)];
+    C6502Trace *const t = c6502_trace_init(&c, buf, sizeof(buf));
+    CHECK(t);
+    CHECK_EQUAL(2, t->capacity);
+
+    CHECK_EQUAL(7, c6502_run(&c, 7));
+    CHECK_EQUAL(3, t->written);
+    char line[128];
+    c6502_trace_format(&t->records[t->written % t->capacity], line, sizeof(line));  // the oldest kept
+    STRCMP_EQUAL("0202  AA        TAX                             A:12 X:00 Y:00 P:24 SP:FD PPU:  0,  0 CYC:2", line);
+    c6502_trace_format(&t->records[0], line, sizeof(line));  // wrapped over the first
+    STRCMP_EQUAL("0203  4C 00 02  JMP $0200                       A:12 X:12 Y:00 P:24 SP:FD PPU:  0,  0 CYC:4", line);
+    c6502_trace_deinit(&c);
+    CHECK_EQUAL(2, c6502_run(&c, 2));
+    CHECK_EQUAL(3, t->written);
+}
+
+TEST(C6502TestGroup, test_trace_skips_bus) {
+    static uint64_t buf[(sizeof(C6502Trace) + sizeof(C6502TraceRecord)) / sizeof(uint64_t)];
+    C6502Trace *const t = c6502_trace_init(&c, buf, sizeof(buf));
+    CHECK(t);
+    c.PC = 0x8000;
+
+    mock_bus::expect_read(0x8000, 0xAD);  // LDA $2002: nothing but the instruction's own reads
+    mock_bus::expect_read(0x8001, 0x02);
+    mock_bus::expect_read(0x8002, 0x20);
+    mock_bus::expect_read(0x2002, 0x80);
+    CHECK_EQUAL(4, c6502_run_next_instruction(&c));
+    CHECK_EQUAL(1, t->written);
+    CHECK_EQUAL(0x8000, t->records[0].pc);
+    CHECK_EQUAL(3, t->records[0].length);
+    CHECK_EQUAL(0xAD, t->records[0].bytes[0]);
+    CHECK_EQUAL(0, t->records[0].bytes[1]);  // no pages mapped
+    CHECK_EQUAL(0, t->records[0].bytes[2]);
+    c6502_trace_deinit(&c);
+}
+
+static uint8_t ram_bus_read(void *ctx, uint16_t addr) {
+    return ((uint8_t *)ctx)[addr];
+}
+
+static bool ram_bus_write(void *ctx, uint16_t addr, uint8_t val) {
+    ((uint8_t *)ctx)[addr] = val;
+    return true;
+}
+
+static C6502BusInterface ram_bus = {
+    .read = ram_bus_read,
+    .write = ram_bus_write,
+};
+
+/** resets stepped and c on the same bus, each on its own copy of what's behind it */
+static void setup_pair(C6502 *const stepped, void *const stepped_ctx, C6502 *const c, void *const ctx,
+                       const C6502BusInterface *const bus) {
+    memset(stepped, 0, sizeof(*stepped));
+    stepped->bus_interface = bus;
+    stepped->bus_ctx = stepped_ctx;
+    c6502_reset(stepped);
+    c->bus_interface = bus;
+    c->bus_ctx = ctx;
+    c6502_reset(c);
+}
+
+static void check_same_state(const C6502 *const stepped, const C6502 *const c) {
+    CHECK_EQUAL(stepped->total_cycles, c->total_cycles);
+    CHECK_EQUAL(stepped->PC, c->PC);
+    CHECK_EQUAL(stepped->AC, c->AC);
+    CHECK_EQUAL(stepped->X, c->X);
+    CHECK_EQUAL(stepped->Y, c->Y);
+    CHECK_EQUAL(stepped->SP, c->SP);
+    CHECK_EQUAL(c6502_status(stepped).u8, c6502_status(c).u8);
+}
+
+TEST(C6502TestGroup, test_run_matches_single_step) {
+    // random code, so every opcode the dispatcher has gets hit
+    static uint8_t mem[2][0x10000];
+    srand(6502);
+    for (size_t i = 0; i < sizeof(mem[0]); i++) {
+        mem[0][i] = mem[1][i] = rand();
+    }
+    C6502 stepped;
+    setup_pair(&stepped, mem[0], &c, mem[1], &ram_bus);
+
+    int64_t cycles = 0;
+    while (cycles < 1000000) {
+        cycles += c6502_run_next_instruction(&stepped);
+    }
+    CHECK_EQUAL(cycles, c6502_run(&c, 1000000));
+    check_same_state(&stepped, &c);
+    MEMCMP_EQUAL(mem[0], mem[1], sizeof(mem[0]));
+}
+
+static bool rom_bus_write(void *ctx, uint16_t addr, uint8_t val) {
+    if (addr < 0x8000) {
+        ((uint8_t *)ctx)[addr] = val;
+    }
+    return true;
+}
+
+static C6502BusInterface rom_bus = {
+    .read = ram_bus_read,
+    .write = rom_bus_write,
+};
+
+TEST(C6502TestGroup, test_block_cache_matches_single_step) {
+    // random code in ram and rom, where it's cached
+    static uint8_t mem[2][0x10000];
+    for (size_t i = 0; i < (0x10000 >> C6502_PAGE_BITS); i++) {
+        read_pages[i] = &mem[1][i << C6502_PAGE_BITS];
+        write_pages[i] = (i < (0x8000 >> C6502_PAGE_BITS)) ? &mem[1][i << C6502_PAGE_BITS] : NULL;
+    }
+    srand(2);
+    for (size_t i = 0; i < sizeof(mem[0]); i++) {
+        mem[0][i] = mem[1][i] = rand();
+    }
+    C6502 stepped;
+    c.read_pages = read_pages;
+    c.write_pages = write_pages;
+    setup_pair(&stepped, mem[0], &c, mem[1], &rom_bus);
+    CHECK(c6502_block_cache_init(&c));
+
+    for (int budget = 1; budget < 2000; budget++) {  // stop at all sorts of points inside blocks
+        int64_t slice = 0;
+        while (slice < budget) {
+            slice += c6502_run_next_instruction(&stepped);
+        }
+        CHECK_EQUAL(slice, c6502_run(&c, budget));
+    }
+    CHECK(c.block_cache_stats.hits > c.block_cache_stats.misses);
+    c6502_block_cache_deinit(&c);
+    check_same_state(&stepped, &c);
+    MEMCMP_EQUAL(mem[0], mem[1], sizeof(mem[0]));
+}
+
+TEST(C6502TestGroup, test_block_cache_register_runs_match_single_step) {
+    static const uint8_t code[] = {
+        // $8000: LDX #0; INX; INY; TXA; CLC; ADC #3; TAY; DEX; SEC; ROL A; STA $10; JMP $8002
+        0xA2, 0x00, 0xE8, 0xC8, 0x8A, 0x18, 0x69, 0x03, 0xA8, 0xCA, 0x38, 0x2A, 0x85, 0x10, 0x4C, 0x02, 0x80,
+    };
+    static uint8_t mem[2][0x10000];
+    for (size_t i = 0; i < (0x10000 >> C6502_PAGE_BITS); i++) {
+        read_pages[i] = &mem[1][i << C6502_PAGE_BITS];
+        write_pages[i] = (i < (0x8000 >> C6502_PAGE_BITS)) ? &mem[1][i << C6502_PAGE_BITS] : NULL;
+    }
+    for (int i = 0; i < 2; i++) {
+        memcpy(&mem[i][0x8000], code, sizeof(code));
+        mem[i][0xFFFC] = 0x00;
+        mem[i][0xFFFD] = 0x80;
+    }
+    C6502 stepped;
+    c.read_pages = read_pages;
+    c.write_pages = write_pages;
+    setup_pair(&stepped, mem[0], &c, mem[1], &rom_bus);
+    CHECK(c6502_block_cache_init(&c));
+
+    for (int budget = 1; budget < 40; budget++) {  // end the run before, within and after the register-only ones
+        int64_t slice = 0;
+        while (slice < budget) {
+            slice += c6502_run_next_instruction(&stepped);
+        }
+        CHECK_EQUAL(slice, c6502_run(&c, budget));
+        check_same_state(&stepped, &c);
+    }
+    c6502_block_cache_deinit(&c);
+    MEMCMP_EQUAL(mem[0], mem[1], sizeof(mem[0]));
+}
+
+// a mapper with one switchable 1KB page at $C000, selected by writes to $8000-$FFFF
+typedef struct {
+    uint8_t banks[2][C6502_PAGE_SIZE];
+    const uint8_t *read_pages[0x10000 >> C6502_PAGE_BITS];
+} BankedBus;
+
+static uint8_t banked_bus_read(void *ctx, uint16_t addr) {
+    const BankedBus *const b = (const BankedBus *)ctx;
+    const uint8_t *const page = b->read_pages[addr >> C6502_PAGE_BITS];
+    return page ? page[addr & (C6502_PAGE_SIZE - 1)] : 0;
+}
+
+static bool banked_bus_write(void *ctx, uint16_t addr, uint8_t val) {
+    BankedBus *const b = (BankedBus *)ctx;
+    if (addr >= 0x8000) {
+        b->read_pages[0xC000 >> C6502_PAGE_BITS] = b->banks[val & 1];
+    }
+    return true;
+}
+
+static C6502BusInterface banked_bus = {
+    .read = banked_bus_read,
+    .write = banked_bus_write,
+};
+
+TEST(C6502TestGroup, test_block_cache_bank_switch) {
+    static const uint8_t code[2][9] = {
+        // $C000: LDA #1; STA $8000 (switches to bank 1); INX or DEX; JMP *
+        {0xA9, 0x01, 0x8D, 0x00, 0x80, 0xE8, 0x4C, 0x06, 0xC0},
+        {0xA9, 0x01, 0x8D, 0x00, 0x80, 0xCA, 0x4C, 0x06, 0xC0},
+    };
+    static BankedBus b;
+    map_ram();
+    memset(&b, 0, sizeof(b));
+    memcpy(b.banks[0], code[0], sizeof(code[0]));
+    memcpy(b.banks[1], code[1], sizeof(code[1]));
+    b.banks[1][0x3FC] = 0x00;  // reset vector, $FFFC in the page mirrored at $FC00
+    b.banks[1][0x3FD] = 0xC0;
+    b.read_pages[0] = ram;
+    b.read_pages[0xC000 >> C6502_PAGE_BITS] = b.banks[0];
+    b.read_pages[0xFC00 >> C6502_PAGE_BITS] = b.banks[1];
+
+    for (int cached = 0; cached < 2; cached++) {
+        b.read_pages[0xC000 >> C6502_PAGE_BITS] = b.banks[0];
+        memset(&c, 0, sizeof(c));
+        c.bus_interface = &banked_bus;
+        c.bus_ctx = &b;
+        c.read_pages = b.read_pages;
+        c.write_pages = write_pages;
+        c6502_reset(&c);
+        CHECK(!cached || c6502_block_cache_init(&c));
+        c6502_run(&c, 100);
+        c6502_block_cache_deinit(&c);
+        CHECK_EQUAL(0xFF, c.X);  // the DEX of the bank switched in
+    }
+}
+
+typedef struct {
+    uint8_t mem[0x10000];
+    const C6502 *cpu;
+} IoBus;
+
+static const uint64_t io_ready_cycle = 5000;
+
+// $4000 reads as a status register whose top bit comes on at io_ready_cycle, like vblank in PPUSTATUS
+static uint8_t io_bus_read(void *ctx, uint16_t addr) {
+    const IoBus *const io = (const IoBus *)ctx;
+    if (addr == 0x4000) {
+        return (io->cpu->total_cycles >= io_ready_cycle) ? 0x80 : 0;
+    }
+    return io->mem[addr];
+}
+
+static bool io_bus_write(void *ctx, uint16_t addr, uint8_t val) {
+    return rom_bus_write(((IoBus *)ctx)->mem, addr, val);
+}
+
+static uint64_t io_bus_stable_until(void *ctx, uint16_t addr) {
+    const IoBus *const io = (const IoBus *)ctx;
+    if (addr != 0x4000) {
+        return 0;
+    }
+    return (io->cpu->total_cycles >= io_ready_cycle) ? UINT64_MAX : io_ready_cycle;
+}
+
+static C6502BusInterface io_bus = {
+    .read = io_bus_read,
+    .write = io_bus_write,
+    .stable_until = io_bus_stable_until,
+};
+
+TEST(C6502TestGroup, test_idle_loop_skip_matches_single_step) {
+    static const uint8_t program[] = {
+        0x2C, 0x00, 0x40,  // $8000: BIT $4000
+        0x10, 0xFB,        //        BPL $8000   ; i/o poll, until io_ready_cycle
+        0xE6, 0x10,        //        INC $10
+        0xA5, 0x11,        // $8007: LDA $11
+        0xF0, 0xFC,        //        BEQ $8007   ; ram poll, forever
+    };
+    static IoBus io[2];
+    for (size_t i = 0; i < (0x10000 >> C6502_PAGE_BITS); i++) {
+        const bool device = (i == (0x4000 >> C6502_PAGE_BITS));
+        read_pages[i] = device ? NULL : &io[1].mem[i << C6502_PAGE_BITS];
+        write_pages[i] = (device || (i >= (0x8000 >> C6502_PAGE_BITS))) ? NULL : &io[1].mem[i << C6502_PAGE_BITS];
+    }
+    for (IoBus *bus = io; bus < &io[2]; bus++) {
+        memset(bus->mem, 0, sizeof(bus->mem));
+        memcpy(&bus->mem[0x8000], program, sizeof(program));
+        bus->mem[0xFFFD] = 0x80;
+    }
+    C6502 stepped;
+    io[0].cpu = &stepped;
+    io[1].cpu = &c;
+    c.read_pages = read_pages;
+    c.write_pages = write_pages;
+    c.skip_idle_loops = true;
+    setup_pair(&stepped, &io[0], &c, &io[1], &io_bus);
+    CHECK(c6502_block_cache_init(&c));
+
+    for (int budget = 1; stepped.total_cycles < 20000; budget = (budget * 7 + 11) % 1500) {
+        int64_t slice = 0;
+        while (slice < budget) {
+            slice += c6502_run_next_instruction(&stepped);
+        }
+        CHECK_EQUAL(slice, c6502_run(&c, budget));
+        CHECK_EQUAL(stepped.PC, c.PC);
+    }
+    CHECK(c.block_cache_stats.idle_cycles > 15000);
+    c6502_block_cache_deinit(&c);
+    check_same_state(&stepped, &c);
+    CHECK_EQUAL(1, io[1].mem[0x10]);
+}
+
 // ASL ZP 5
 TEST(C6502TestGroup, test_0x06) {
-    c.SR.u8 = 0;
+    c6502_set_status(&c, 0);
     c.PC = 123;
     mock_bus::expect_read(123, 0x06);
     mock_bus::expect_read(124, 51);
@@ -68,11 +461,11 @@ TEST(C6502TestGroup, test_0x06) {
     mock_bus::expect_write(51, 0b01001111, true);
     mock_bus::expect_write(51, 0b10011110, true);
     CHECK_EQUAL(5, c6502_run_next_instruction(&c));
-    CHECK_EQUAL(c.SR.C, 0);
-    CHECK_EQUAL(c.SR.N, 1);
-    CHECK_EQUAL(c.SR.Z, 0);
+    CHECK_EQUAL(c6502_status(&c).C, 0);
+    CHECK_EQUAL(c6502_status(&c).N, 1);
+    CHECK_EQUAL(c6502_status(&c).Z, 0);
 
-    c.SR.u8 = 0;
+    c6502_set_status(&c, 0);
     c.PC = 123;
     mock_bus::expect_read(123, 0x06);
     mock_bus::expect_read(124, 51);
@@ -80,23 +473,23 @@ TEST(C6502TestGroup, test_0x06) {
     mock_bus::expect_write(51, 0b10000000, true);
     mock_bus::expect_write(51, 0, true);
     CHECK_EQUAL(5, c6502_run_next_instruction(&c));
-    CHECK_EQUAL(c.SR.C, 1);
-    CHECK_EQUAL(c.SR.N, 0);
-    CHECK_EQUAL(c.SR.Z, 1);
+    CHECK_EQUAL(c6502_status(&c).C, 1);
+    CHECK_EQUAL(c6502_status(&c).N, 0);
+    CHECK_EQUAL(c6502_status(&c).Z, 1);
 }
 
 // ASL ACC 2
 TEST(C6502TestGroup, test_0x0A) {
-    c.SR.u8 = 0;
+    c6502_set_status(&c, 0);
     c.PC = 900;
     mock_bus::expect_read(900, 0x0A);
     c.AC = 0b10000001;
     CHECK_EQUAL(2, c6502_run_next_instruction(&c));
     CHECK_EQUAL(c.AC, 0b00000010);
     CHECK_EQUAL(c.PC, 901);
-    CHECK_EQUAL(c.SR.N, 0);
-    CHECK_EQUAL(c.SR.C, 1);
-    CHECK_EQUAL(c.SR.Z, 0);
+    CHECK_EQUAL(c6502_status(&c).N, 0);
+    CHECK_EQUAL(c6502_status(&c).C, 1);
+    CHECK_EQUAL(c6502_status(&c).Z, 0);
 }
 
 // ASL ABS 6
@@ -118,21 +511,21 @@ TEST(C6502TestGroup, test_0x10) {
     mock_bus::expect_read(2000, 0x10);
     mock_bus::expect_read(2001, 124);
 
-    c.SR.N = 0;
+    c6502_set_status(&c, 0);
     CHECK_EQUAL(4, c6502_run_next_instruction(&c));
     CHECK_EQUAL(c.PC, 2126);
 
     c.PC = 2000;
     mock_bus::expect_read(2000, 0x10);
     mock_bus::expect_read(2001, -124);
-    c.SR.N = 0;
+    c6502_set_status(&c, 0);
     CHECK_EQUAL(3, c6502_run_next_instruction(&c));
     CHECK_EQUAL(c.PC, 2000 - 122);
 
     c.PC = 2000;
     mock_bus::expect_read(2000, 0x10);
     mock_bus::expect_read(2001, -124);
-    c.SR.N = 1;
+    c6502_set_status(&c, 0x80);  // N
     CHECK_EQUAL(2, c6502_run_next_instruction(&c));
     CHECK_EQUAL(c.PC, 2002);
 }
@@ -150,8 +543,8 @@ TEST(C6502TestGroup, test_0x11) {
     c.AC = 0b00000001;
     CHECK_EQUAL(5, c6502_run_next_instruction(&c));
     CHECK_EQUAL(c.AC, 0b11001101);
-    CHECK_EQUAL(c.SR.Z, 0);
-    CHECK_EQUAL(c.SR.N, 1);
+    CHECK_EQUAL(c6502_status(&c).Z, 0);
+    CHECK_EQUAL(c6502_status(&c).N, 1);
 
     c.PC = 500;
     c.Y = 0xF0;
@@ -163,8 +556,8 @@ TEST(C6502TestGroup, test_0x11) {
     c.AC = 0b1;
     CHECK_EQUAL(6, c6502_run_next_instruction(&c));
     CHECK_EQUAL(c.AC, 0b11);
-    CHECK_EQUAL(c.SR.Z, 0);
-    CHECK_EQUAL(c.SR.N, 0);
+    CHECK_EQUAL(c6502_status(&c).Z, 0);
+    CHECK_EQUAL(c6502_status(&c).N, 0);
 }
 
 // ORA ZPX 4
@@ -196,13 +589,70 @@ TEST(C6502TestGroup, test_0x18) {
     c.PC = 500;
     mock_bus::expect_read(500, 0x18);
 
-    c.SR.u8 = ~0;
-    c.SR.C = 1;
+    c6502_set_status(&c, ~0);
 
     CHECK_EQUAL(2, c6502_run_next_instruction(&c));
     CHECK_EQUAL(c.PC, 501);
-    CHECK_EQUAL(c.SR.C, 0);
-    CHECK_EQUAL(c.SR.u8, 0b11111110);
+    CHECK_EQUAL(c6502_status(&c).C, 0);
+    CHECK_EQUAL(c6502_status(&c).u8, 0b11111110);
+}
+
+// JAM IMP, fetched over and over
+TEST(C6502TestGroup, test_0x02) {
+    c.PC = 500;
+    for (int i = 0; i < 3; i++) {
+        mock_bus::expect_read(500, 0x02);
+        CHECK_EQUAL(2, c6502_run_next_instruction(&c));
+        CHECK_EQUAL(c.PC, 500);
+    }
+}
+
+// ARR IMM 2
+TEST(C6502TestGroup, test_0x6B) {
+    c.PC = 500;
+    c.AC = 0b11110000;
+    c6502_set_status(&c, 0x01);  // C
+    mock_bus::expect_read(500, 0x6B);
+    mock_bus::expect_read(501, 0b01100110);
+    CHECK_EQUAL(2, c6502_run_next_instruction(&c));
+    CHECK_EQUAL(c.PC, 502);
+    CHECK_EQUAL(0b10110000, c.AC);
+    CHECK_EQUAL(0, c6502_status(&c).C);  // bit 6
+    CHECK_EQUAL(1, c6502_status(&c).V);  // bit 6 ^ bit 5
+    CHECK_EQUAL(1, c6502_status(&c).N);
+}
+
+// AXS IMM 2
+TEST(C6502TestGroup, test_0xCB) {
+    c.PC = 500;
+    c.AC = 0b00111100;
+    c.X = 0b11110000;
+    mock_bus::expect_read(500, 0xCB);
+    mock_bus::expect_read(501, 0x31);
+    CHECK_EQUAL(2, c6502_run_next_instruction(&c));
+    CHECK_EQUAL(0xFF, c.X);  // 0x30 - 0x31
+    CHECK_EQUAL(0, c6502_status(&c).C);
+    CHECK_EQUAL(1, c6502_status(&c).N);
+    CHECK_EQUAL(0b00111100, c.AC);
+}
+
+// SHX ABY 5
+TEST(C6502TestGroup, test_0x9E) {
+    c.PC = 500;
+    c.X = 0x0F;
+    c.Y = 1;
+    mock_bus::expect_read(500, 0x9E);
+    mock_bus::expect_read(501, 0x00);
+    mock_bus::expect_read(502, 0x12);
+    mock_bus::expect_write(0x1201, 0x03, true);  // X & ($12 + 1)
+    CHECK_EQUAL(5, c6502_run_next_instruction(&c));
+
+    c.Y = 2;
+    mock_bus::expect_read(503, 0x9E);
+    mock_bus::expect_read(504, 0xFF);
+    mock_bus::expect_read(505, 0x12);
+    mock_bus::expect_write(0x0301, 0x03, true);  // crossing to $1301 puts the value in the high byte too
+    CHECK_EQUAL(5, c6502_run_next_instruction(&c));
 }
 
 // Todo - remaining cpu tests
@@ -376,7 +826,6 @@ TEST(C6502TestGroup, test_0x18) {
 
 // TEST(C6502TestGroup, test_0x9C) {}
 // TEST(C6502TestGroup, test_0x9D) {}
-// TEST(C6502TestGroup, test_0x9E) {}
 
 // TEST(C6502TestGroup, test_0xA0) {}
 // TEST(C6502TestGroup, test_0xA1) {}
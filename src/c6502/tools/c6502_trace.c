@@ -0,0 +1,40 @@
+// Prints a trace file written through c6502_trace_init() as nestest.log style text, oldest instruction first.
+// usage: c6502_trace <trace file> [last n instructions]
+
+#include <c6502.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace file> [last n instructions]\n", argv[0]);
+        return 1;
+    }
+    const int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if ((fd < 0) || (0 != fstat(fd, &st)) || ((size_t)st.st_size < sizeof(C6502Trace))) {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+    const C6502Trace *const t = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if ((MAP_FAILED == t) || (0 != memcmp(t->magic, C6502_TRACE_MAGIC, sizeof(t->magic))) ||
+        (0 == t->capacity) || (t->capacity > (st.st_size - sizeof(C6502Trace)) / sizeof(C6502TraceRecord))) {
+        fprintf(stderr, "%s is not a trace\n", argv[1]);
+        return 1;
+    }
+
+    const uint64_t kept = (t->written < t->capacity) ? t->written : t->capacity;
+    const uint64_t wanted = (argc > 2) ? strtoull(argv[2], NULL, 0) : kept;
+    const uint64_t n = (wanted < kept) ? wanted : kept;
+    char line[128];
+    for (uint64_t i = t->written - n; i < t->written; i++) {
+        c6502_trace_format(&t->records[i % t->capacity], line, sizeof(line));
+        puts(line);
+    }
+    return 0;
+}
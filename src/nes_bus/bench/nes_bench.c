@@ -0,0 +1,271 @@
+// Throughput of each part of the emulator, as one JSON object on stdout to keep as a baseline and compare against:
+// - cpu: instructions/s on a synthetic mix (interpreted and with the block cache) and on nestest
+// - ppu: dots/s with rendering on and off
+// - frames/s of every rom nes_cart_init() can load under the rom folder
+// - bus: cpu reads and writes/s per region of the memory map
+// usage: nes_bench [rom folder] [frames per rom]
+
+#define _XOPEN_SOURCE 700  // nftw
+
+#include <ftw.h>
+#include <nes_bus.h>
+#include <nes_cart.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const double MIN_SECONDS = 0.5;  // each measurement repeats until it took at least this long
+
+static NesBus bus;
+static uint16_t frame[C2C02_HEIGHT * C2C02_WIDTH];
+static const char *sep = "";
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** calls fn until MIN_SECONDS have passed, returns the units of work it reported per second */
+static double measure(uint64_t (*fn)(void *), void *ctx) {
+    uint64_t units = 0;
+    const double start = now();
+    double elapsed;
+    do {
+        units += fn(ctx);
+        elapsed = now() - start;
+    } while (elapsed < MIN_SECONDS);
+    return units / elapsed;
+}
+
+static void result(const char *const name, const double value) {
+    printf("%s\n  \"%s\": %.0f", sep, name, value);
+    fflush(stdout);
+    sep = ",";
+}
+
+// cpu on a flat 64K bus, the program in read-only pages like prg-rom
+
+#define CPU_CYCLES 1000000
+
+static uint8_t mem[0x10000];
+static const uint8_t *read_pages[0x10000 >> C6502_PAGE_BITS];
+static uint8_t *write_pages[0x10000 >> C6502_PAGE_BITS];
+
+static uint8_t mem_read(void *, uint16_t addr) {
+    return mem[addr];
+}
+
+static bool mem_write(void *, uint16_t addr, uint8_t val) {
+    mem[addr] = val;
+    return true;
+}
+
+static const C6502BusInterface mem_bus = {
+    .read = mem_read,
+    .write = mem_write,
+};
+
+// mixes loads, stores, read-modify-writes, arithmetic and branches over the common addressing modes
+static const uint8_t program[] = {
+    0xA2, 0x00,        // $8000       LDX #$00
+    0xBD, 0x00, 0x02,  // $8002 loop: LDA $0200,X
+    0x18,              //             CLC
+    0x65, 0x10,        //             ADC $10
+    0x85, 0x10,        //             STA $10
+    0xB1, 0x20,        //             LDA ($20),Y
+    0x49, 0x5A,        //             EOR #$5A
+    0x9D, 0x00, 0x03,  //             STA $0300,X
+    0xE6, 0x11,        //             INC $11
+    0x0A,              //             ASL A
+    0x66, 0x12,        //             ROR $12
+    0xE8,              //             INX
+    0xD0, 0xE9,        //             BNE loop
+    0xC8,              //             INY
+    0x4C, 0x02, 0x80,  //             JMP loop
+};
+
+static void cpu_reset(C6502 *const c) {
+    memset(mem, 0, sizeof(mem));
+    memcpy(&mem[0x8000], program, sizeof(program));
+    mem[0x20] = 0x00;  // ($20) -> $0400
+    mem[0x21] = 0x04;
+    mem[0xFFFC] = 0x00;
+    mem[0xFFFD] = 0x80;
+    for (size_t page = 0; page < (0x10000 >> C6502_PAGE_BITS); page++) {
+        read_pages[page] = &mem[page << C6502_PAGE_BITS];
+        write_pages[page] = (page < (0x8000 >> C6502_PAGE_BITS)) ? &mem[page << C6502_PAGE_BITS] : NULL;
+    }
+    struct C6502BlockCache *const block_cache = c->block_cache;
+    memset(c, 0, sizeof(*c));
+    c->block_cache = block_cache;  // still right, the program is the same every time
+    c->bus_interface = &mem_bus;
+    c->read_pages = read_pages;
+    c->write_pages = write_pages;
+    c6502_reset(c);
+}
+
+typedef struct {
+    C6502 cpu;
+    uint64_t instructions;  // in CPU_CYCLES from reset
+} CpuBench;
+
+static uint64_t cpu_synthetic(void *const ctx) {
+    CpuBench *const b = ctx;
+    cpu_reset(&b->cpu);
+    c6502_run(&b->cpu, CPU_CYCLES);
+    return b->instructions;
+}
+
+static void bench_cpu_synthetic(void) {
+    CpuBench b = {0};
+    cpu_reset(&b.cpu);
+    for (int64_t cycles = 0; cycles < CPU_CYCLES; b.instructions++) {
+        cycles += c6502_run_next_instruction(&b.cpu);
+    }
+    result("cpu.synthetic.instructions_per_sec", measure(cpu_synthetic, &b));
+    c6502_block_cache_init(&b.cpu);  // once, out of the timing
+    result("cpu.synthetic_block_cache.instructions_per_sec", measure(cpu_synthetic, &b));
+    c6502_block_cache_deinit(&b.cpu);
+}
+
+/** nestest's automated mode from $C000, one instruction at a time. Returns the instructions */
+static uint64_t cpu_nestest(void *const ctx) {
+    static const uint16_t TERMINATE_PC = 0x8000;
+    bus = *(const NesBus *)ctx;
+    nes_bus_init(&bus);
+    bus.ram[0x100 + bus.cpu.SP + 1] = (TERMINATE_PC - 1) & 0xFF;
+    bus.ram[0x100 + bus.cpu.SP + 2] = (TERMINATE_PC - 1) >> 8;
+    bus.cpu.PC = 0xC000;
+    nes_bus_step(&bus);  // the reset sequence
+    uint64_t instructions = 0;
+    for (; (TERMINATE_PC != bus.cpu.PC) && (instructions < 100000); instructions++) {
+        nes_bus_step(&bus);
+    }
+    nes_bus_deinit(&bus);
+    return instructions;
+}
+
+static void bench_cpu_nestest(void) {
+    static NesBus pristine;
+    nes_cart_init(&pristine.cart, NES_BENCH_NESTEST);
+    result("cpu.nestest.instructions_per_sec", measure(cpu_nestest, &pristine));
+    nes_cart_deinit(&pristine.cart);
+}
+
+// ppu on its own, rendering whatever nestest left in vram
+
+#define PPU_DOTS 1000000
+
+static uint64_t ppu_run(void *) {
+    c2C02_run(&bus.ppu, bus.ppu.clocks + PPU_DOTS);
+    return PPU_DOTS;
+}
+
+static void bench_ppu(void) {
+    memset(&bus, 0, sizeof(bus));
+    nes_cart_init(&bus.cart, NES_BENCH_NESTEST);
+    nes_bus_init(&bus);
+    bus.ppu.framebuffer = frame;
+    nes_bus_run_frame(&bus);
+    nes_bus_run_frame(&bus);
+    c2C02_write_reg(&bus.ppu, 1, 0x1E);  // PPUMASK: background and sprites, left column included
+    result("ppu.rendering.dots_per_sec", measure(ppu_run, NULL));
+    c2C02_write_reg(&bus.ppu, 1, 0x00);
+    result("ppu.off.dots_per_sec", measure(ppu_run, NULL));
+    nes_bus_deinit(&bus);
+    nes_cart_deinit(&bus.cart);
+}
+
+// cpu reads and writes through the bus, per region. The cpu itself loads and stores ram and prg-rom through the
+// page tables instead, these are what's left going through nes_bus_cpu_read() and nes_bus_cpu_write()
+
+#define BUS_ACCESSES 1000000
+
+typedef struct {
+    const char *name;
+    uint16_t start;
+    uint16_t end;  // inclusive
+    bool write;
+} BusRegion;
+
+static uint64_t bus_access(void *const ctx) {
+    const BusRegion *const r = ctx;
+    const uint32_t size = r->end - r->start + 1;
+    for (uint32_t i = 0; i < BUS_ACCESSES; i++) {
+        const uint16_t addr = r->start + (i % size);
+        if (!r->write) {
+            nes_bus_cpu_read(&bus, addr);
+        } else if (0x4014 != addr) {  // not dma
+            nes_bus_cpu_write(&bus, addr, i);
+        }
+    }
+    return BUS_ACCESSES;
+}
+
+static void bench_bus(void) {
+    static const BusRegion regions[] = {
+        {"ram", 0x0000, 0x1FFF, false},     {"ppu", 0x2000, 0x3FFF, false},     {"apu_io", 0x4000, 0x401F, false},
+        {"prg_ram", 0x6000, 0x7FFF, false}, {"prg_rom", 0x8000, 0xFFFF, false},
+    };
+    memset(&bus, 0, sizeof(bus));
+    nes_cart_init(&bus.cart, NES_BENCH_NESTEST);
+    nes_bus_init(&bus);
+    bus.ppu.framebuffer = frame;
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        char name[64];
+        BusRegion region = regions[i];
+        snprintf(name, sizeof(name), "bus.%s.reads_per_sec", region.name);
+        result(name, measure(bus_access, &region));
+        region.write = true;
+        snprintf(name, sizeof(name), "bus.%s.writes_per_sec", region.name);
+        result(name, measure(bus_access, &region));
+    }
+    nes_bus_deinit(&bus);
+    nes_cart_deinit(&bus.cart);
+}
+
+// whole frames of each rom, from power on
+
+static int frames_per_rom = 120;
+
+static uint64_t rom_frames(void *const ctx) {
+    memset(&bus, 0, sizeof(bus));
+    nes_cart_init(&bus.cart, ctx);
+    nes_bus_init(&bus);
+    bus.ppu.framebuffer = frame;
+    for (int i = 0; i < frames_per_rom; i++) {
+        nes_bus_run_frame(&bus);
+    }
+    nes_bus_deinit(&bus);
+    nes_cart_deinit(&bus.cart);
+    return frames_per_rom;
+}
+
+static const char *roms_folder;
+
+static int bench_rom(const char *const path, const struct stat *, const int type, struct FTW *) {
+    const size_t len = strlen(path);
+    if ((FTW_F != type) || (len < 4) || (0 != strcmp(&path[len - 4], ".nes")) || !nes_cart_can_load(path)) {
+        return 0;
+    }
+    char name[1024];
+    snprintf(name, sizeof(name), "rom.%s.frames_per_sec", &path[strlen(roms_folder) + 1]);
+    result(name, measure(rom_frames, (void *)path));
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    roms_folder = (argc > 1) ? argv[1] : NES_BENCH_ROMS;
+    frames_per_rom = (argc > 2) ? atoi(argv[2]) : frames_per_rom;
+
+    printf("{");
+    bench_cpu_synthetic();
+    bench_cpu_nestest();
+    bench_ppu();
+    bench_bus();
+    nftw(roms_folder, bench_rom, 16, FTW_PHYS);
+    printf("\n}\n");
+    return 0;
+}
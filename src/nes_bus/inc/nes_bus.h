@@ -8,6 +8,47 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// https://www.nesdev.org/wiki/Cycle_reference_chart
+#define NES_BUS_PPU_DOTS_PER_CPU_CYCLE 3
+// Points the bus stops the cpu at, to act on their exact master clock. Other timed things stay out of the queue:
+// - the vblank nmi is raised by the ppu itself as it runs into vblank. NES_BUS_EVENT_VBLANK only makes sure it gets
+//   run that far in time
+// - oam dma copies its 256 bytes in the $4014 write and stalls the cpu for the 513-514 cycles it takes. Only the
+//   ppu's sprite evaluation could tell, and games don't run dma while rendering
+// - mappers raise their irq through NesCart.irq from a cpu access, which the ppu was synced for. A mapper counting
+//   cpu cycles schedules NES_BUS_EVENT_IRQ instead, and one counting ppu fetches has to predict its irq the same way
+//   VBLANK is predicted: the ppu only catches up when something observes it
+typedef enum {
+    NES_BUS_EVENT_FRAME_END,  // ppu wraps from scanline 260 to the pre-render scanline
+    NES_BUS_EVENT_VBLANK,     // ppu is about to raise the vblank nmi
+    NES_BUS_EVENT_IRQ,        // assert the cpu irq line (e.g. mapper timers)
+    NES_BUS_EVENT_TYPES,
+} NesBusEventType;
+
+typedef struct {
+    uint64_t timestamp;  // master clock
+    NesBusEventType type;
+} NesBusEvent;
+
+// a cpu write that changes what the ppu draws: to PPUCTRL, PPUMASK, PPUSCROLL, PPUADDR, PPUDATA, or to a mapper
+// register (bank switching, mirroring)
+typedef struct {
+    uint64_t clock;  // master clock, the ppu dot it took effect on
+    int16_t scanline;
+    int16_t dot;
+    uint16_t addr;
+    uint8_t val;
+} NesBusWrite;
+
+// writes in the order they happened, one frame at a time, e.g. to see where a game splits the screen. The bus has
+// already applied each of them at its exact dot, this is a record of them
+typedef struct {
+    uint64_t frame;  // C2C02.frames the entries are from. The log restarts on the first write of a new frame
+    size_t count;    // this frame's writes. Only the first `capacity` of them are kept
+    size_t capacity;
+    NesBusWrite *entries;  // caller provided
+} NesBusWriteLog;
+
 typedef struct {
     uint8_t ram[0x800];
     uint8_t vram[2][0x400];
@@ -18,7 +59,18 @@ typedef struct {
 
     NesGamepad gamepad[2];
 
-    int cpu_subcycle_count;
+    // master clock, in ppu dots. Everything up to here has been emulated. Components run ahead in slices rather than
+    // in lock-step: the cpu runs uninterrupted up to the next event, and the ppu only catches up to the cpu's time
+    // when the cpu could observe it (register or mapper access, dma), when the vblank nmi is due, and at the end of a
+    // slice.
+    uint64_t clock;
+
+    struct {
+        NesBusEvent queue[NES_BUS_EVENT_TYPES];  // sorted by timestamp. at most one pending event per type
+        size_t count;
+    } events;
+
+    NesBusWriteLog *write_log;  // optional
 } NesBus;
 
 bool nes_bus_cpu_write(NesBus *, uint16_t addr, uint8_t val);
@@ -28,6 +80,19 @@ uint8_t nes_bus_ppu_read(NesBus *, uint16_t addr);
 
 void nes_bus_init(NesBus *);
 
-void nes_bus_cycle(NesBus *);
+/** frees what nes_bus_init() allocated, e.g. the cpu's block cache. The cart is the caller's, see nes_cart_deinit() */
+void nes_bus_deinit(NesBus *);
+
+/** schedule an event at the given master clock. replaces any pending event of the same type */
+void nes_bus_schedule(NesBus *, NesBusEventType, uint64_t timestamp);
+
+/** run until the master clock reaches the given clock. Cpu instructions starting at or before it are executed */
+void nes_bus_run(NesBus *, uint64_t clock);
+
+/** run until the ppu finishes the current frame */
+void nes_bus_run_frame(NesBus *);
+
+/** run the cpu's next instruction (or pending stall), and catch everything else up to the end of it */
+void nes_bus_step(NesBus *);
 
 void nes_bus_reset(NesBus *);
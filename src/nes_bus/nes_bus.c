@@ -1,7 +1,14 @@
 
+#include <assert.h>
 #include <c2C02.h>
 #include <c6502.h>
 #include <nes_bus.h>
+#include <string.h>
+
+/** catch the ppu up to the cpu instruction currently executing. Its bus accesses all happen at its first cycle */
+inline static void sync_ppu(NesBus *const bus) {
+    c2C02_run(&bus->ppu, bus->cpu.total_cycles * NES_BUS_PPU_DOTS_PER_CPU_CYCLE);
+}
 
 // https://www.nesdev.org/wiki/CPU_memory_map
 
@@ -11,8 +18,48 @@ static void nes_bus_ppu_dma(NesBus *bus, const uint16_t page) {
     }
 }
 
+/** records a write the ppu was just synced for, if it changes what the ppu draws */
+static void log_write(NesBus *const bus, const uint16_t addr, const uint8_t val) {
+    NesBusWriteLog *const log = bus->write_log;
+    if (addr < 0x4000) {
+        if (((addr & 0x7) >= 2) && ((addr & 0x7) <= 4)) {
+            return;  // PPUSTATUS, OAMADDR, OAMDATA: not the registers behind raster effects
+        }
+    } else if (addr < 0x4020) {
+        return;  // apu and i/o
+    }
+    if (log->frame != bus->ppu.frames) {
+        log->frame = bus->ppu.frames;
+        log->count = 0;
+    }
+    if (log->count < log->capacity) {
+        log->entries[log->count] = (NesBusWrite){
+            .clock = bus->ppu.clocks,
+            .scanline = bus->ppu.scanline,
+            .dot = bus->ppu.dot,
+            .addr = addr,
+            .val = val,
+        };
+    }
+    log->count++;
+}
+
 bool nes_bus_cpu_write(NesBus *bus, uint16_t addr, uint8_t val) {
+    uint8_t *const page = bus->cart.cpu_pages.write[addr >> NES_CART_CPU_PAGE_BITS];
+    if (page) {  // ram
+        page[addr & (NES_CART_CPU_PAGE_SIZE - 1)] = val;
+        return true;
+    }
+    if (((addr >= 0x2000) && (addr < 0x4000)) || (addr == 0x4014) || (addr >= 0x4020)) {
+        sync_ppu(bus);  // register write, dma, or mapper write that may switch chr banks / mirroring under the ppu
+        if (bus->write_log && (addr < 0x4020)) {
+            log_write(bus, addr, val);
+        }
+    }
     if (nes_cart_cpu_write(&bus->cart, addr, val)) {
+        if (bus->write_log && (addr >= 0x4020)) {
+            log_write(bus, addr, val);  // the mapper took it
+        }
         return true;
     }
     if (addr < 0x2000) {
@@ -38,6 +85,10 @@ bool nes_bus_cpu_write(NesBus *bus, uint16_t addr, uint8_t val) {
 }
 
 uint8_t nes_bus_cpu_read(NesBus *bus, uint16_t addr) {
+    const uint8_t *const page = bus->cart.cpu_pages.read[addr >> NES_CART_CPU_PAGE_BITS];
+    if (page) {  // ram, prg-rom
+        return page[addr & (NES_CART_CPU_PAGE_SIZE - 1)];
+    }
     uint8_t val;
     if (nes_cart_cpu_read(&bus->cart, addr, &val)) {
         return val;
@@ -46,6 +97,7 @@ uint8_t nes_bus_cpu_read(NesBus *bus, uint16_t addr) {
         return bus->ram[addr & (sizeof(bus->ram) - 1)];
     }
     if (addr < 0x4000) {
+        sync_ppu(bus);
         return c2C02_read_reg(&bus->ppu, addr & 0x7);
     }
     if (addr < 0x4020) {
@@ -59,14 +111,40 @@ uint8_t nes_bus_cpu_read(NesBus *bus, uint16_t addr) {
     return 0;
 }
 
+/** lets the cpu skip loops polling PPUSTATUS until it next changes. Other i/o isn't known to be stable */
+static uint64_t cpu_stable_until(NesBus *const bus, const uint16_t addr) {
+    if ((addr < 0x2000) || (addr >= 0x4000) || ((addr & 0x7) != 0x2)) {
+        return 0;
+    }
+    sync_ppu(bus);
+    return c2C02_status_stable_until(&bus->ppu) / NES_BUS_PPU_DOTS_PER_CPU_CYCLE;
+}
+
+/** where the ppu is when the traced instruction starts. The ppu never runs ahead of that */
+static void cpu_trace_position(NesBus *const bus, const uint64_t cycle, int16_t *const scanline, int16_t *const dot) {
+    c2C02_run(&bus->ppu, cycle * NES_BUS_PPU_DOTS_PER_CPU_CYCLE);
+    *scanline = bus->ppu.scanline;
+    *dot = bus->ppu.dot;
+}
+
 static const C6502BusInterface bus_interface = {
     .read = (uint8_t(*)(void *, uint16_t))nes_bus_cpu_read,
     .write = (bool (*)(void *, uint16_t, uint8_t))nes_bus_cpu_write,
+    .stable_until = (uint64_t(*)(void *, uint16_t))cpu_stable_until,
+    .trace_position = (void (*)(void *, uint64_t, int16_t *, int16_t *))cpu_trace_position,
 };
 
 // https://www.nesdev.org/wiki/PPU_memory_map
 
+static_assert(NES_CART_PPU_PAGE_BITS == C2C02_BUS_PAGE_BITS, "ppu reads the cart's pages directly");
+static_assert(NES_CART_CPU_PAGE_BITS == C6502_PAGE_BITS, "cpu reads the cart's pages directly");
+
 bool nes_bus_ppu_write(NesBus *bus, uint16_t addr, uint8_t val) {
+    uint8_t *const page = bus->cart.ppu_pages.write[(addr & 0x3FFF) >> NES_CART_PPU_PAGE_BITS];
+    if (page) {  // chr-ram, vram
+        page[addr & (NES_CART_PPU_PAGE_SIZE - 1)] = val;
+        return true;
+    }
     if (nes_cart_ppu_write(&bus->cart, addr, val)) {
         return true;  // probably CHR-rom or CHR-ram
     }
@@ -78,6 +156,10 @@ bool nes_bus_ppu_write(NesBus *bus, uint16_t addr, uint8_t val) {
 }
 
 uint8_t nes_bus_ppu_read(NesBus *bus, uint16_t addr) {
+    const uint8_t *const page = bus->cart.ppu_pages.read[(addr & 0x3FFF) >> NES_CART_PPU_PAGE_BITS];
+    if (page) {  // chr, vram
+        return page[addr & (NES_CART_PPU_PAGE_SIZE - 1)];
+    }
     uint8_t val;
     if (nes_cart_ppu_read(&bus->cart, addr, &val)) {
         return val;  // probably CHR-rom or CHR-ram
@@ -93,27 +175,139 @@ static const C2C02BusInterface ppu_bus_interface = {
     .write = (bool (*)(void *, uint16_t, uint8_t))nes_bus_ppu_write,
 };
 
+/** the ppu raises the nmi while processing (241, 2). The event fires a dot early, as cpu instructions starting on the
+ * event's clock run before it is dispatched, but the one starting on the nmi's clock has to see it */
+static void schedule_vblank(NesBus *const bus) {
+    nes_bus_schedule(bus, NES_BUS_EVENT_VBLANK, c2C02_clock_at(&bus->ppu, 241, 2) - 1);
+}
+
 void nes_bus_init(NesBus *const bus) {
     bus->cpu.bus_ctx = bus;
     bus->cpu.bus_interface = &bus_interface;
     bus->ppu.bus_ctx = bus;
     bus->ppu.bus = &ppu_bus_interface;
+    bus->ppu.bus_pages = bus->cart.ppu_pages.read;
     bus->ppu.nmi.callback = (void (*)(void *))c6502_nmi;
     bus->ppu.nmi.ctx = &bus->cpu;
     bus->cart.irq.callback = (void (*)(void *))c6502_irq;
     bus->cart.irq.arg = &bus->cpu;
+    nes_cart_map_cpu(&bus->cart, 0x0000, 0x2000, bus->ram, sizeof(bus->ram), true);  // mirrored every 2K
+    bus->cart.ciram = bus->vram;
+    nes_cart_map_nametables(&bus->cart);
+    bus->cpu.read_pages = bus->cart.cpu_pages.read;
+    bus->cpu.write_pages = bus->cart.cpu_pages.write;
+    c6502_block_cache_init(&bus->cpu);
+    bus->cpu.skip_idle_loops = !bus->cart.no_idle_loop_skip;
+    bus->cart.chr_bank_switch.callback = (void (*)(void *))c2C02_invalidate_chr;
+    bus->cart.chr_bank_switch.arg = &bus->ppu;
+    c2C02_invalidate_chr(&bus->ppu);
+
+    bus->clock = 0;
+    bus->cpu.total_cycles = 0;
+    bus->ppu.clocks = 0;
+    bus->ppu.last_status_read_clocks = 0;
+    bus->events.count = 0;
+    nes_bus_schedule(bus, NES_BUS_EVENT_FRAME_END, c2C02_clock_at(&bus->ppu, 260, 340));
+    schedule_vblank(bus);
+
     nes_bus_reset(bus);
 }
 
-void nes_bus_cycle(NesBus *const bus) {
-    c2C02_cycle(&bus->ppu);
+void nes_bus_deinit(NesBus *const bus) {
+    c6502_block_cache_deinit(&bus->cpu);
+}
+
+void nes_bus_schedule(NesBus *const bus, const NesBusEventType type, const uint64_t timestamp) {
+    typeof(&bus->events) const events = &bus->events;
+    size_t i = 0;
+    while ((i < events->count) && (events->queue[i].type != type)) {
+        i++;
+    }
+    if (i < events->count) {  // drop the pending one
+        memmove(&events->queue[i], &events->queue[i + 1], (events->count - i - 1) * sizeof(events->queue[0]));
+        events->count--;
+    }
+    assert(events->count < (sizeof(events->queue) / sizeof(events->queue[0])));
+
+    // insertion sort, keeping events of equal timestamp in the order they were scheduled
+    for (i = events->count++; (i > 0) && (events->queue[i - 1].timestamp > timestamp); i--) {
+        events->queue[i] = events->queue[i - 1];
+    }
+    events->queue[i] = (NesBusEvent){.timestamp = timestamp, .type = type};
+}
+
+/** ppu clock at which the cpu's next instruction touches the bus (3 dots per elapsed cpu cycle) */
+inline static uint64_t cpu_next_clock(const NesBus *const bus) {
+    return (bus->cpu.total_cycles + 1) * NES_BUS_PPU_DOTS_PER_CPU_CYCLE;
+}
+
+/** run cpu instructions that start at or before the given clock. The ppu is left behind, to be synced on demand */
+static void run_cpu(NesBus *const bus, const uint64_t clock) {
+    while (cpu_next_clock(bus) <= clock) {  // c6502_run returns early to service interrupts
+        c6502_run(&bus->cpu, (int64_t)(clock / NES_BUS_PPU_DOTS_PER_CPU_CYCLE) - (int64_t)bus->cpu.total_cycles);
+    }
+}
+
+/** handle all events that are due. returns true if a frame ended */
+static bool dispatch_events(NesBus *const bus) {
+    typeof(&bus->events) const events = &bus->events;
+    bool frame_end = false;
+    while ((events->count > 0) && (events->queue[0].timestamp <= bus->clock)) {
+        const NesBusEvent event = events->queue[0];
+        memmove(&events->queue[0], &events->queue[1], (--events->count) * sizeof(events->queue[0]));
 
-    if (3 == ++bus->cpu_subcycle_count) {
-        bus->cpu_subcycle_count = 0;
-        c6502_cycle(&bus->cpu);
+        switch (event.type) {
+            case NES_BUS_EVENT_FRAME_END: {
+                // prediction may be a dot early if the odd-frame skip didn't happen; just re-check next dot
+                frame_end = (bus->ppu.scanline == -1) && (bus->ppu.dot == 0);
+                nes_bus_schedule(bus, NES_BUS_EVENT_FRAME_END, c2C02_clock_at(&bus->ppu, 260, 340));
+                break;
+            }
+            case NES_BUS_EVENT_VBLANK: {
+                // if the prediction was a dot early, (241, 2) is still pending and gets rescheduled for the next dot
+                c2C02_run(&bus->ppu, event.timestamp + 1);
+                schedule_vblank(bus);
+                break;
+            }
+            case NES_BUS_EVENT_IRQ: {
+                c6502_irq(&bus->cpu);
+                break;
+            }
+            case NES_BUS_EVENT_TYPES:
+                break;
+        }
+    }
+    return frame_end;
+}
+
+static void run(NesBus *const bus, const uint64_t clock, const bool stop_at_frame_end) {
+    while (bus->clock < clock) {
+        uint64_t next = clock;
+        if ((bus->events.count > 0) && (bus->events.queue[0].timestamp < next)) {
+            next = bus->events.queue[0].timestamp;
+        }
+        run_cpu(bus, next);
+        c2C02_run(&bus->ppu, next);
+        bus->clock = next;
+        if (dispatch_events(bus) && stop_at_frame_end) {
+            return;
+        }
     }
 }
 
+void nes_bus_run(NesBus *const bus, const uint64_t clock) {
+    run(bus, clock, false);
+}
+
+void nes_bus_run_frame(NesBus *const bus) {
+    run(bus, UINT64_MAX, true);
+}
+
+void nes_bus_step(NesBus *const bus) {
+    nes_bus_run(bus, cpu_next_clock(bus));  // starts exactly one cpu instruction or stall
+    nes_bus_run(bus, bus->cpu.total_cycles * NES_BUS_PPU_DOTS_PER_CPU_CYCLE);
+}
+
 void nes_bus_reset(NesBus *const bus) {
     c6502_reset(&bus->cpu);
     // ToDo - reset other stuff
@@ -13,6 +13,7 @@ TEST_GROUP(NesBusTestGroup) {
     NesBus bus;
 
     TEST_SETUP() {
+        memset(&bus, 0, sizeof(bus));
         bus.cart.mapper = &mapper_000;
     }
 
@@ -63,3 +64,76 @@ TEST(NesBusTestGroup, test_ppu_cart_mirroring) {
     nes_bus_ppu_write(&bus, 0x3C01, 0xEE);
     CHECK_EQUAL(0xEE, bus.vram[1][1]);
 }
+
+TEST(NesBusTestGroup, test_ppu_nametable_pages) {
+    bus.cart.ciram = bus.vram;
+    bus.cart.mirror_type = NesCart::NES_CART_MIRROR_HORIZONTAL;
+    nes_cart_map_nametables(&bus.cart);
+    CHECK(bus.cart.ppu_pages.read[0x2400 >> NES_CART_PPU_PAGE_BITS] == bus.vram[0]);
+    CHECK(bus.cart.ppu_pages.read[0x2800 >> NES_CART_PPU_PAGE_BITS] == bus.vram[1]);
+
+    nes_bus_ppu_write(&bus, 0x3801, 0xBB);
+    CHECK_EQUAL(0xBB, bus.vram[1][1]);
+    CHECK_EQUAL(0xBB, nes_bus_ppu_read(&bus, 0x2C01));
+
+    bus.cart.mirror_type = NesCart::NES_CART_MIRROR_VERTICAL;
+    nes_cart_map_nametables(&bus.cart);
+    CHECK_EQUAL(0xBB, nes_bus_ppu_read(&bus, 0x2401));
+    CHECK_EQUAL(0xBB, nes_bus_ppu_read(&bus, 0x2C01));
+
+    // four-screen: the cart provides $2800-$2FFF
+    uint8_t ext_vram[0x800] = {0};
+    bus.cart.ext_vram = &ext_vram;
+    nes_cart_map_nametables(&bus.cart);
+    nes_bus_ppu_write(&bus, 0x2C01, 0xCC);
+    CHECK_EQUAL(0xCC, ext_vram[0x401]);
+    CHECK_EQUAL(0xBB, nes_bus_ppu_read(&bus, 0x2401));
+    CHECK_EQUAL(0, nes_bus_ppu_read(&bus, 0x2801));
+}
+
+TEST(NesBusTestGroup, test_event_queue_order) {
+    bus.events.count = 0;
+    nes_bus_schedule(&bus, NES_BUS_EVENT_IRQ, 100);
+    nes_bus_schedule(&bus, NES_BUS_EVENT_FRAME_END, 50);
+    CHECK_EQUAL(2, bus.events.count);
+    CHECK_EQUAL(NES_BUS_EVENT_FRAME_END, bus.events.queue[0].type);
+    CHECK_EQUAL(50, bus.events.queue[0].timestamp);
+    CHECK_EQUAL(NES_BUS_EVENT_IRQ, bus.events.queue[1].type);
+
+    // rescheduling replaces the pending event
+    nes_bus_schedule(&bus, NES_BUS_EVENT_FRAME_END, 150);
+    CHECK_EQUAL(2, bus.events.count);
+    CHECK_EQUAL(NES_BUS_EVENT_IRQ, bus.events.queue[0].type);
+    CHECK_EQUAL(NES_BUS_EVENT_FRAME_END, bus.events.queue[1].type);
+    CHECK_EQUAL(150, bus.events.queue[1].timestamp);
+}
+
+TEST(NesBusTestGroup, test_write_log) {
+    NesBusWrite entries[2];
+    NesBusWriteLog log = {.frame = 0, .count = 0, .capacity = 2, .entries = entries};
+    bus.write_log = &log;
+    bus.cpu.total_cycles = 100;
+
+    nes_bus_cpu_write(&bus, 0x2002, 0x00);  // read-only
+    nes_bus_cpu_write(&bus, 0x4016, 0x01);  // i/o
+    nes_bus_cpu_write(&bus, 0x8000, 0x01);  // nrom has no registers there
+    nes_bus_cpu_write(&bus, 0x2001, 0x1E);
+    CHECK_EQUAL(1, log.count);
+    CHECK_EQUAL(300, entries[0].clock);  // the ppu caught up to the write first
+    CHECK_EQUAL(0, entries[0].scanline);
+    CHECK_EQUAL(300, entries[0].dot);
+    CHECK_EQUAL(0x2001, entries[0].addr);
+    CHECK_EQUAL(0x1E, entries[0].val);
+
+    nes_bus_cpu_write(&bus, 0x2005, 0x10);
+    nes_bus_cpu_write(&bus, 0x2005, 0x20);  // counted, not kept
+    CHECK_EQUAL(3, log.count);
+    CHECK_EQUAL(0x2005, entries[1].addr);
+    CHECK_EQUAL(0x10, entries[1].val);
+
+    bus.ppu.frames++;
+    nes_bus_cpu_write(&bus, 0x2000, 0x80);
+    CHECK_EQUAL(1, log.frame);
+    CHECK_EQUAL(1, log.count);
+    CHECK_EQUAL(0x2000, entries[0].addr);
+}
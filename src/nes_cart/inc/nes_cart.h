@@ -4,12 +4,22 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#define NES_CART_CPU_PAGE_BITS 10  // 1KB
+#define NES_CART_CPU_PAGE_SIZE (1 << NES_CART_CPU_PAGE_BITS)
+#define NES_CART_PPU_PAGE_BITS 10  // 1KB
+#define NES_CART_PPU_PAGE_SIZE (1 << NES_CART_PPU_PAGE_BITS)
+
 typedef struct NesCart {
     struct {
         void (*callback)(void *arg);
         void *arg;
     } irq;
 
+    struct {
+        void (*callback)(void *arg);
+        void *arg;
+    } chr_bank_switch;  // different chr is now mapped into ppu $0000-$1FFF
+
     struct {
         union {
             size_t size;
@@ -58,7 +68,26 @@ typedef struct NesCart {
         NES_CART_MIRROR_VERTICAL = 1,    // VRAM_A10 connects to PPU_A10
     } mirror_type;
 
-    uint8_t (*ext_vram)[0x800];
+    uint8_t (*ext_vram)[0x800];  // four-screen boards: nametables $2800-$2FFF live on the cart
+    uint8_t (*ciram)[0x400];     // console internal vram, provided by the console
+
+    // per-rom opt-out of the cpu fast-forwarding idle loops (C6502.skip_idle_loops), for games that rely on a loop's
+    // exact iterations. Set after nes_cart_init(), before nes_bus_init()
+    bool no_idle_loop_skip;
+
+    // cpu address space as pages of host memory that can be accessed directly. NULL pages go through the mapper's
+    // cpu_read / cpu_write. Mappers keep $4020-$FFFF up to date as they bank switch, the bus maps its internal ram
+    struct {
+        const uint8_t *read[0x10000 >> NES_CART_CPU_PAGE_BITS];
+        uint8_t *write[0x10000 >> NES_CART_CPU_PAGE_BITS];
+    } cpu_pages;
+
+    // ppu address space $0000-$3FFF, same as cpu_pages. Mappers keep the pattern tables up to date as they bank
+    // switch, and call nes_cart_map_nametables() once mirroring changes
+    struct {
+        const uint8_t *read[0x4000 >> NES_CART_PPU_PAGE_BITS];
+        uint8_t *write[0x4000 >> NES_CART_PPU_PAGE_BITS];
+    } ppu_pages;
 
     // https://www.nesdev.org/wiki/Mapper
     const struct NesCartMapperInterface {
@@ -81,6 +110,38 @@ void nes_cart_init_from_data(NesCart *, const uint8_t *buf, size_t buf_size);
 void nes_cart_deinit(NesCart *);
 void nes_cart_reset(NesCart *);
 
+/** whether nes_cart_init() can load the file: an iNES rom without a trainer, for a mapper that's implemented */
+bool nes_cart_can_load(const char *filename);
+
+static inline void _nes_cart_map_pages(const uint8_t **const read, uint8_t **const write, const size_t page_bits,
+                                       const uint16_t addr, const size_t size, const uint8_t *const buf,
+                                       const size_t buf_size, const bool writable) {
+    for (size_t offset = 0; offset < size; offset += (1 << page_bits)) {
+        const size_t page = (addr + offset) >> page_bits;
+        const uint8_t *const mem = buf ? &buf[offset & (buf_size - 1)] : NULL;
+        read[page] = mem;
+        write[page] = writable ? (uint8_t *)mem : NULL;
+    }
+}
+
+/** points the cpu pages of [addr, addr + size) at buf, repeating it every buf_size bytes. A NULL buf routes the range
+ * to the mapper instead. Sizes and addr are multiples of NES_CART_CPU_PAGE_SIZE, buf_size a power of 2 */
+static inline void nes_cart_map_cpu(NesCart *const cart, const uint16_t addr, const size_t size,
+                                    const uint8_t *const buf, const size_t buf_size, const bool writable) {
+    _nes_cart_map_pages(cart->cpu_pages.read, cart->cpu_pages.write, NES_CART_CPU_PAGE_BITS, addr, size, buf, buf_size,
+                        writable);
+}
+
+/** same as nes_cart_map_cpu(), for the ppu pages */
+static inline void nes_cart_map_ppu(NesCart *const cart, const uint16_t addr, const size_t size,
+                                    const uint8_t *const buf, const size_t buf_size, const bool writable) {
+    _nes_cart_map_pages(cart->ppu_pages.read, cart->ppu_pages.write, NES_CART_PPU_PAGE_BITS, addr, size, buf, buf_size,
+                        writable);
+}
+
+/** maps $2000-$2FFF (and its $3000-$3EFF mirror) to ciram and ext_vram according to mirror_type */
+void nes_cart_map_nametables(NesCart *);
+
 static inline bool nes_cart_cpu_write(NesCart *const cart, uint16_t addr, uint8_t val) {
     return cart->mapper->cpu_write(cart, addr, val);
 }
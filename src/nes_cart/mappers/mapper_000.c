@@ -61,10 +61,25 @@ bool mapper_000_ppu_read(NesCart *const cart, uint16_t addr, uint8_t *const val_
     return true;
 }
 
+void mapper_000_map_chr(NesCart *const cart) {
+    if (cart->chr_ram.buf) {
+        nes_cart_map_ppu(cart, 0x0000, 0x2000, cart->chr_ram.buf, 0x2000, true);
+    } else {
+        nes_cart_map_ppu(cart, 0x0000, 0x2000, cart->chr_rom.buf, 0x2000, false);
+    }
+}
+
+void mapper_000_init(NesCart *const cart) {
+    nes_cart_map_cpu(cart, 0x6000, 0x2000, cart->prg_ram.buf, cart->prg_ram.size, true);
+    nes_cart_map_cpu(cart, 0x8000, 0x8000, cart->prg_rom.buf, cart->prg_rom.size, false);  // 16K carts mirrored
+    mapper_000_map_chr(cart);
+}
+
 const struct NesCartMapperInterface mapper_000 = {
     .name = "NROM",
     .cpu_write = mapper_000_cpu_write,
     .cpu_read = mapper_000_cpu_read,
     .ppu_write = mapper_000_ppu_write,
     .ppu_read = mapper_000_ppu_read,
+    .init = mapper_000_init,
 };
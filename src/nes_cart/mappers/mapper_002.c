@@ -2,11 +2,19 @@
 
 #include "../nes_cart_impl.h"
 
+static void map_prg(NesCart *const cart) {
+    const uint8_t bank = cart->mapper_data;
+    const bool present = bank < cart->prg_rom.banks;
+    nes_cart_map_cpu(cart, 0x8000, 0x4000, present ? &cart->prg_rom.buf[bank << 14] : NULL, 0x4000, false);
+    nes_cart_map_cpu(cart, 0xC000, 0x4000, &cart->prg_rom.buf[(cart->prg_rom.banks - 1) << 14], 0x4000, false);
+}
+
 bool mapper_002_cpu_write(NesCart *const cart, uint16_t addr, uint8_t val) {
     if (addr < 0x8000) {
         return false;
     }
     cart->mapper_data = val;
+    map_prg(cart);
     return true;
 }
 
@@ -15,6 +23,9 @@ static bool mapper_002_cpu_read(NesCart *const cart, uint16_t addr, uint8_t *con
         return false;
     }
     const uint8_t bank = (addr >= 0xC000) ? (cart->prg_rom.banks - 1) : ((uint8_t)cart->mapper_data);
+    if (bank >= cart->prg_rom.banks) {
+        return false;
+    }
     *val_out = cart->prg_rom.buf[(bank << 14) | (addr & ((1 << 14) - 1))];
     return true;
 }
@@ -22,6 +33,12 @@ static bool mapper_002_cpu_read(NesCart *const cart, uint16_t addr, uint8_t *con
 // same as NROM
 bool mapper_000_ppu_write(NesCart *const cart, uint16_t addr, uint8_t val);
 bool mapper_000_ppu_read(NesCart *const cart, uint16_t addr, uint8_t *const val_out);
+void mapper_000_map_chr(NesCart *const cart);
+
+static void mapper_002_init(NesCart *const cart) {
+    map_prg(cart);
+    mapper_000_map_chr(cart);
+}
 
 const struct NesCartMapperInterface mapper_002 = {
     .name = "UxROM",
@@ -29,4 +46,5 @@ const struct NesCartMapperInterface mapper_002 = {
     .cpu_read = mapper_002_cpu_read,
     .ppu_write = mapper_000_ppu_write,
     .ppu_read = mapper_000_ppu_read,
+    .init = mapper_002_init,
 };
@@ -2,11 +2,22 @@
 
 #include "../nes_cart_impl.h"
 
+static void map_chr(NesCart *const cart) {
+    const uint8_t bank = cart->mapper_data & 3;
+    const bool present = bank < cart->chr_rom.banks;
+    nes_cart_map_ppu(cart, 0x0000, 0x2000, present ? &cart->chr_rom.buf[bank << 13] : NULL, 0x2000, false);
+}
+
 bool mapper_003_cpu_write(NesCart *const cart, uint16_t addr, uint8_t val) {
     if (addr < 0x8000) {
         return false;
     }
+    const bool chr_bank_switch = (cart->mapper_data ^ val) & 3;
     cart->mapper_data = val;
+    if (chr_bank_switch) {
+        map_chr(cart);
+        nes_cart_chr_bank_switch(cart);
+    }
     return true;
 }
 
@@ -19,6 +30,11 @@ bool mapper_003_cpu_read(NesCart *const cart, uint16_t addr, uint8_t *const val_
     return true;
 }
 
+static void mapper_003_init(NesCart *const cart) {
+    nes_cart_map_cpu(cart, 0x8000, 0x8000, cart->prg_rom.buf, cart->prg_rom.size, false);  // 16K carts mirrored
+    map_chr(cart);
+}
+
 bool mapper_000_ppu_write(NesCart *const cart, uint16_t addr, uint8_t val);
 
 bool mapper_003_ppu_read(NesCart *const cart, uint16_t addr, uint8_t *const val_out) {
@@ -38,4 +54,5 @@ const struct NesCartMapperInterface mapper_003 = {
     .cpu_read = mapper_003_cpu_read,
     .ppu_write = mapper_000_ppu_write,
     .ppu_read = mapper_003_ppu_read,
+    .init = mapper_003_init,
 };
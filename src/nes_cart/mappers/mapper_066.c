@@ -13,11 +13,43 @@ typedef union {
     };
 } mapper_066_reg;
 
+/** true if the selected 32K bank is all in prg rom. prg_rom.banks counts 16K ones */
+static bool prg_present(const NesCart *const cart) {
+    const mapper_066_reg *const reg = (const mapper_066_reg *)(&cart->mapper_data);
+    return ((size_t)(reg->prg_rom_bank + 1) << 15) <= cart->prg_rom.size;
+}
+
+static void map_prg(NesCart *const cart) {
+    const mapper_066_reg *const reg = (mapper_066_reg *)(&cart->mapper_data);
+    const bool present = prg_present(cart);
+    nes_cart_map_cpu(cart, 0x8000, 0x8000, present ? &cart->prg_rom.buf[reg->prg_rom_bank << 15] : NULL, 0x8000,
+                     false);
+}
+
+static void map_chr(NesCart *const cart) {
+    const mapper_066_reg *const reg = (mapper_066_reg *)(&cart->mapper_data);
+    const bool present = reg->chr_rom_bank < cart->chr_rom.banks;
+    nes_cart_map_ppu(cart, 0x0000, 0x2000, present ? &cart->chr_rom.buf[reg->chr_rom_bank << 13] : NULL, 0x2000,
+                     false);
+}
+
+static void mapper_066_init(NesCart *const cart) {
+    map_prg(cart);
+    map_chr(cart);
+}
+
 bool mapper_066_cpu_write(NesCart *const cart, uint16_t addr, uint8_t val) {
     if (addr < 0x8000) {
         return false;
     }
+    const mapper_066_reg *const reg = (mapper_066_reg *)(&cart->mapper_data);
+    const uint8_t chr_rom_bank = reg->chr_rom_bank;
     cart->mapper_data = val;
+    map_prg(cart);
+    if (reg->chr_rom_bank != chr_rom_bank) {
+        map_chr(cart);
+        nes_cart_chr_bank_switch(cart);
+    }
     return true;
 }
 
@@ -26,7 +58,7 @@ bool mapper_066_cpu_read(NesCart *const cart, uint16_t addr, uint8_t *const val_
         return false;
     }
     const mapper_066_reg *const reg = (mapper_066_reg *)(&cart->mapper_data);
-    if (reg->prg_rom_bank >= cart->prg_rom.banks) {
+    if (!prg_present(cart)) {
         return false;
     }
     *val_out = cart->prg_rom.buf[(reg->prg_rom_bank << 15) | (addr & 0x7FFF)];
@@ -56,4 +88,5 @@ const struct NesCartMapperInterface mapper_066 = {
     .cpu_read = mapper_066_cpu_read,
     .ppu_write = mapper_000_ppu_write,
     .ppu_read = mapper_066_ppu_read,
+    .init = mapper_066_init,
 };
@@ -28,6 +28,21 @@ void nes_cart_reset(NesCart *const cart) {
     }
 }
 
+// https://www.nesdev.org/wiki/Mirroring#Nametable_Mirroring
+void nes_cart_map_nametables(NesCart *const cart) {
+    for (size_t nt = 0; nt < 4; nt++) {
+        uint8_t *mem = NULL;
+        if (cart->ext_vram && (nt >= 2)) {
+            mem = &(*cart->ext_vram)[(nt & 1) * 0x400];
+        } else if (cart->ciram) {
+            const bool vertical = cart->ext_vram || (cart->mirror_type == NES_CART_MIRROR_VERTICAL);
+            mem = cart->ciram[vertical ? (nt & 1) : (nt >> 1)];
+        }
+        nes_cart_map_ppu(cart, 0x2000 + nt * 0x400, 0x400, mem, 0x400, true);
+        nes_cart_map_ppu(cart, 0x3000 + nt * 0x400, 0x400, mem, 0x400, true);
+    }
+}
+
 static size_t read_from_file(void *arg, void *const dest, size_t size) {
     return fread(dest, size, 1, (FILE *)arg);
 }
@@ -97,10 +112,23 @@ static void _nes_cart_init_from_src(NesCart *const cart, size_t (*read_func)(voi
     assert(cart->mapper->ppu_read);
     assert(cart->mapper->ppu_write);
 
+    cart->mirror_type = header.flags6.mirroring;
     if (NULL != mapper_table[mapper_num]->init) {
         mapper_table[mapper_num]->init(cart);
     }
-    cart->mirror_type = header.flags6.mirroring;
+}
+
+bool nes_cart_can_load(const char *const filename) {
+    RawCartridgeHeader header = {0};
+    FILE *const f = fopen(filename, "rb");
+    if (NULL == f) {
+        return false;
+    }
+    const bool read = (1 == read_from_file(f, &header, sizeof(header)));
+    fclose(f);
+    const size_t mapper_num = (header.flags7.mapper_high << 4) | header.flags6.mapper_low;
+    return read && (0 == memcmp(header_cookie, header.header_cookie, sizeof(header_cookie))) &&
+           !header.flags6.has_trainer && (mapper_num < mapper_table_size) && (NULL != mapper_table[mapper_num]);
 }
 
 void nes_cart_init(NesCart *const cart, const char *const filename) {
@@ -67,6 +67,12 @@ static inline void nes_cart_irq(const NesCart *const cart) {
     }
 }
 
+static inline void nes_cart_chr_bank_switch(const NesCart *const cart) {
+    if (cart->chr_bank_switch.callback) {
+        cart->chr_bank_switch.callback(cart->chr_bank_switch.arg);
+    }
+}
+
 typedef struct __attribute__((__packed__)) {
     uint16_t : 10;  // 0-9
     uint16_t A10 : 1;
@@ -59,4 +59,29 @@ TEST(mapper_002TestGroup, test_basic) {
     CHECK_EQUAL(0x44, val);
     CHECK(mapper_002.cpu_read(&cart, 0xC000, &val));
     CHECK_EQUAL(0x44, val);
-}
\ No newline at end of file
+}
+
+TEST(mapper_002TestGroup, test_cpu_pages) {
+    uint8_t *const wbuf = (uint8_t *)cart.prg_rom.buf;
+    wbuf[0x4000 + 0x3FFF] = 0x22;
+    wbuf[0x8000 + 0x400] = 0x33;
+    wbuf[0xC000 + 0x3FFF] = 0x44;
+
+    cart.mapper_data = 0;
+    mapper_002.init(&cart);
+    CHECK(cart.cpu_pages.read[0x8000 >> NES_CART_CPU_PAGE_BITS] == &wbuf[0]);
+    CHECK(NULL == cart.cpu_pages.write[0x8000 >> NES_CART_CPU_PAGE_BITS]);  // bank select goes to the mapper
+    CHECK_EQUAL(0x44, cart.cpu_pages.read[0xFFFF >> NES_CART_CPU_PAGE_BITS][0x3FF]);
+
+    CHECK(mapper_002.cpu_write(&cart, 0x8000, 1));
+    CHECK_EQUAL(0x22, cart.cpu_pages.read[0xBFFF >> NES_CART_CPU_PAGE_BITS][0x3FF]);
+    CHECK(mapper_002.cpu_write(&cart, 0x8000, 2));
+    CHECK_EQUAL(0x33, cart.cpu_pages.read[0x8400 >> NES_CART_CPU_PAGE_BITS][0]);
+    CHECK_EQUAL(0x44, cart.cpu_pages.read[0xFFFF >> NES_CART_CPU_PAGE_BITS][0x3FF]);
+
+    uint8_t val = 0;
+    CHECK(mapper_002.cpu_write(&cart, 0x8000, 4));  // past the rom's 4 banks
+    CHECK(NULL == cart.cpu_pages.read[0x8000 >> NES_CART_CPU_PAGE_BITS]);
+    CHECK_FALSE(mapper_002.cpu_read(&cart, 0x8000, &val));
+    CHECK_EQUAL(0x44, cart.cpu_pages.read[0xFFFF >> NES_CART_CPU_PAGE_BITS][0x3FF]);
+}
@@ -0,0 +1,46 @@
+#include <CppUTest/TestHarness.h>
+#include <CppUTestExt/MockSupport.h>
+
+extern "C" {
+#include <nes_cart.h>
+#include <stdlib.h>
+#include <string.h>
+}
+
+extern const struct NesCart::NesCartMapperInterface mapper_066;
+
+TEST_GROUP(mapper_066TestGroup) {
+    NesCart cart;
+    TEST_SETUP() {
+        memset(&cart, 0, sizeof(cart));
+        cart.mapper = &mapper_066;
+        cart.prg_rom.banks = 4;  // 64K, two 32K banks
+        cart.prg_rom.buf = (uint8_t *)calloc(1, cart.prg_rom.size);
+        cart.chr_rom.banks = 4;
+        cart.chr_rom.buf = (uint8_t *)calloc(1, cart.chr_rom.size);
+    }
+
+    TEST_TEARDOWN() {
+        mock().checkExpectations();
+        mock().clear();
+        free((void *)cart.prg_rom.buf);
+        free(cart.chr_rom.buf);
+    }
+};
+
+TEST(mapper_066TestGroup, test_cpu_pages) {
+    uint8_t *const wbuf = (uint8_t *)cart.prg_rom.buf;
+    wbuf[0x8000 + 0x7FFF] = 0x22;
+
+    mapper_066.init(&cart);
+    CHECK(cart.cpu_pages.read[0x8000 >> NES_CART_CPU_PAGE_BITS] == &wbuf[0]);
+
+    CHECK(mapper_066.cpu_write(&cart, 0x8000, 0x10));  // prg bank 1
+    CHECK_EQUAL(0x22, cart.cpu_pages.read[0xFFFF >> NES_CART_CPU_PAGE_BITS][0x3FF]);
+
+    uint8_t val = 0;
+    CHECK(mapper_066.cpu_write(&cart, 0x8000, 0x20));  // prg bank 2, past the rom's 64K
+    CHECK(NULL == cart.cpu_pages.read[0x8000 >> NES_CART_CPU_PAGE_BITS]);
+    CHECK(NULL == cart.cpu_pages.read[0xFFFF >> NES_CART_CPU_PAGE_BITS]);
+    CHECK_FALSE(mapper_066.cpu_read(&cart, 0x8000, &val));
+}
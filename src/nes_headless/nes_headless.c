@@ -0,0 +1,220 @@
+// Runs a rom without a window or frame pacing, for batch validation and scripted play. Stops after the given frames
+// or emulated seconds, whichever comes first, and reports how fast it went and hashes of the final ram and
+// framebuffer as JSON on stdout.
+// usage: nes_headless [--frames n] [--seconds s] [--render-every n] [--write-log] [--no-idle-skip]
+//                     [--input script] rom.nes
+//
+// --seconds s runs the frames of s seconds of NTSC video, so the hashes are the same from run to run like --frames.
+// --render-every n draws 1 frame in every n, plus the last one. The frames in between skip the pixel work
+// but run the same otherwise, so the hashes don't change.
+// --write-log adds the last frame's raster-relevant register writes, with the scanline and dot each landed on.
+// --no-idle-skip runs every iteration of the rom's idle loops, see NesCart.no_idle_loop_skip.
+//
+// An input script sets a gamepad's buttons from a frame on, one change per line:
+//   # frame pad buttons
+//   60 1 Start
+//   90 1 -
+//   120 1 A+Right
+
+#include <getopt.h>
+#include <nes_bus.h>
+#include <nes_cart.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const double NTSC_FPS = 60.0988;
+static const char USAGE[] =
+    "[--frames n] [--seconds s] [--render-every n] [--write-log] [--no-idle-skip] [--input script] rom.nes";
+static const size_t WRITE_LOG_CAPACITY = 4096;
+
+typedef struct {
+    long frame;
+    int pad;  // 0 or 1
+    uint8_t buttons;
+} InputChange;
+
+static NesBus bus;
+static uint16_t frame[C2C02_HEIGHT * C2C02_WIDTH];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+static uint64_t fnv1a(const void *const data, const size_t size) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ ((const uint8_t *)data)[i]) * 0x100000001B3;
+    }
+    return hash;
+}
+
+/** NesGamepad bits for e.g. "A+Right", "-" for none. false on an unknown button */
+static bool parse_buttons(char *const text, uint8_t *const out) {
+    static const char *const names[8] = {"A", "B", "Select", "Start", "Up", "Down", "Left", "Right"};
+    *out = 0;
+    if (0 == strcmp(text, "-")) {
+        return true;
+    }
+    for (char *name = strtok(text, "+"); name; name = strtok(NULL, "+")) {
+        int bit = 0;
+        while ((bit < 8) && (0 != strcmp(name, names[bit]))) {
+            bit++;
+        }
+        if (8 == bit) {
+            return false;
+        }
+        *out |= 1 << bit;
+    }
+    return true;
+}
+
+/** reads an input script, in frame order. Returns the number of changes, -1 on errors */
+static long load_input(const char *const path, InputChange **const changes) {
+    FILE *const f = fopen(path, "rt");
+    if (NULL == f) {
+        fprintf(stderr, "can't read %s\n", path);
+        return -1;
+    }
+    long count = 0;
+    *changes = NULL;
+    char line[256];
+    for (int line_num = 1; fgets(line, sizeof(line), f); line_num++) {
+        char buttons[128];
+        InputChange change;
+        if (('#' == line[0]) || (strspn(line, " \t\r\n") == strlen(line))) {
+            continue;
+        }
+        if ((3 != sscanf(line, "%ld %d %127s", &change.frame, &change.pad, buttons)) || (change.pad < 1) ||
+            (change.pad > 2) || !parse_buttons(buttons, &change.buttons) ||
+            ((count > 0) && (change.frame < (*changes)[count - 1].frame))) {
+            fprintf(stderr, "%s:%d: expected <frame, in order> <pad 1|2> <buttons like A+Right or ->\n", path,
+                    line_num);
+            fclose(f);
+            return -1;
+        }
+        change.pad--;
+        InputChange *const grown = realloc(*changes, (count + 1) * sizeof(**changes));
+        if (NULL == grown) {
+            fprintf(stderr, "out of memory reading %s\n", path);
+            free(*changes);
+            *changes = NULL;
+            fclose(f);
+            return -1;
+        }
+        *changes = grown;
+        (*changes)[count++] = change;
+    }
+    fclose(f);
+    return count;
+}
+
+int main(int argc, char **argv) {
+    static const struct option options[] = {
+        {"frames", required_argument, NULL, 'f'},
+        {"seconds", required_argument, NULL, 's'},
+        {"input", required_argument, NULL, 'i'},
+        {"render-every", required_argument, NULL, 'r'},
+        {"write-log", no_argument, NULL, 'w'},
+        {"no-idle-skip", no_argument, NULL, 'n'},
+        {0},
+    };
+    long max_frames = -1;
+    long render_every = 1;
+    NesBusWriteLog write_log = {0};
+    double max_seconds = -1;
+    bool no_idle_skip = false;
+    InputChange *input = NULL;
+    long input_count = 0;
+    for (int opt; -1 != (opt = getopt_long(argc, argv, "f:s:i:r:wn", options, NULL));) {
+        if ('f' == opt) {
+            max_frames = atol(optarg);
+        } else if ('s' == opt) {
+            max_seconds = atof(optarg);
+        } else if (('r' == opt) && (atol(optarg) > 0)) {
+            render_every = atol(optarg);
+        } else if ('w' == opt) {
+            write_log.capacity = WRITE_LOG_CAPACITY;
+        } else if ('n' == opt) {
+            no_idle_skip = true;
+        } else if ('i' == opt) {
+            input_count = load_input(optarg, &input);
+            if (input_count < 0) {
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "usage: %s %s\n", argv[0], USAGE);
+            return 1;
+        }
+    }
+    if ((optind != argc - 1) || !nes_cart_can_load(argv[optind])) {
+        fprintf(stderr, "usage: %s %s (iNES, known mapper)\n", argv[0], USAGE);
+        return 1;
+    }
+    if ((max_frames < 0) && (max_seconds < 0)) {
+        max_frames = 600;
+    }
+
+    nes_cart_init(&bus.cart, argv[optind]);
+    bus.cart.no_idle_loop_skip = no_idle_skip;
+    nes_bus_init(&bus);
+    bus.ppu.framebuffer = frame;
+    if (write_log.capacity) {
+        write_log.entries = malloc(write_log.capacity * sizeof(*write_log.entries));
+        if (NULL == write_log.entries) {
+            fprintf(stderr, "out of memory for the write log\n");
+            return 1;
+        }
+        bus.write_log = &write_log;
+    }
+
+    const double start = now();
+    const clock_t cpu_start = clock();
+    long frames = 0;
+    long next_input = 0;
+    while (((max_frames < 0) || (frames < max_frames)) && ((max_seconds < 0) || (frames < max_seconds * NTSC_FPS))) {
+        for (; (next_input < input_count) && (input[next_input].frame <= frames); next_input++) {
+            bus.gamepad[input[next_input].pad].u8 = input[next_input].buttons;
+        }
+        const bool last = (frames + 1 == max_frames) || ((max_seconds >= 0) && (frames + 1 >= max_seconds * NTSC_FPS));
+        bus.ppu.skip_video = ((frames + 1) % render_every != 0) && !last;
+        nes_bus_run_frame(&bus);
+        frames++;
+    }
+    const double elapsed = now() - start;
+    const double cpu_seconds = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    printf("{\n");
+    printf("  \"rom\": \"%s\",\n", argv[optind]);
+    printf("  \"frames\": %ld,\n", frames);
+    printf("  \"render_every\": %ld,\n", render_every);
+    printf("  \"emulated_seconds\": %.3f,\n", frames / NTSC_FPS);
+    printf("  \"host_seconds\": %.3f,\n", elapsed);
+    printf("  \"host_cpu_seconds\": %.3f,\n", cpu_seconds);
+    printf("  \"fps\": %.1f,\n", (elapsed > 0) ? (frames / elapsed) : 0.0);
+    printf("  \"ram_hash\": \"%016llx\",\n", (unsigned long long)fnv1a(bus.ram, sizeof(bus.ram)));
+    printf("  \"framebuffer_hash\": \"%016llx\"%s\n", (unsigned long long)fnv1a(frame, sizeof(frame)),
+           bus.write_log ? "," : "");
+    if (bus.write_log) {
+        const size_t kept = (write_log.count < write_log.capacity) ? write_log.count : write_log.capacity;
+        printf("  \"write_log\": {\"frame\": %llu, \"count\": %zu, \"writes\": [", (unsigned long long)write_log.frame,
+               write_log.count);
+        for (size_t i = 0; i < kept; i++) {
+            const NesBusWrite *const w = &write_log.entries[i];
+            printf("%s\n    {\"scanline\": %d, \"dot\": %d, \"addr\": \"$%04X\", \"val\": \"$%02X\"}", i ? "," : "",
+                   w->scanline, w->dot, w->addr, w->val);
+        }
+        printf("\n  ]}\n");
+    }
+    printf("}\n");
+
+    nes_bus_deinit(&bus);
+    nes_cart_deinit(&bus.cart);
+    free(input);
+    free(write_log.entries);
+    return 0;
+}
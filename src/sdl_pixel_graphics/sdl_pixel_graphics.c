@@ -5,10 +5,14 @@
 #include <nes_bus.h>
 #include <nes_cart.h>
 #include <stdbool.h>
+#include <string.h>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define EMSCRIPTEN_KEEPALIVE
 static bool quit = false;
@@ -28,6 +32,7 @@ static void emscripten_cancel_main_loop() {
 #define SCREEN_HEIGHT (240 + 1)
 
 static uint32_t scr[SCREEN_HEIGHT][SCREEN_WIDTH] = {{~0}};
+static C2C02Palette palette;
 
 static struct {
     SDL_Window *window;
@@ -57,6 +62,7 @@ void spg_init(void) {
     s->texture = SDL_CreateTexture(s->renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH,
                                    SCREEN_HEIGHT);
     SDL_SetTextureScaleMode(s->texture, SDL_ScaleModeBest);
+    c2C02_palette_init(&palette, C2C02_ABGR8888);  // same as the texture
 }
 
 void spg_handle_events(void) {
@@ -126,9 +132,7 @@ typedef union __attribute__((__packed__)) {
     };
 } nes_chr_tile;
 
-void render(void *, int x, int y, uint8_t r, uint8_t g, uint8_t b) {
-    spg_draw_pixel(x, y, r, g, b);
-}
+static uint16_t frame[C2C02_HEIGHT * C2C02_WIDTH] __attribute__((aligned(32)));
 
 #ifdef __EMSCRIPTEN__
 static bool running = false;
@@ -136,16 +140,56 @@ EMSCRIPTEN_KEEPALIVE
 int jscallback(uint8_t *data, size_t length) {
     nes_cart_init_from_data(&bus.cart, data, length);
     nes_bus_init(&bus);
-    bus.ppu.draw_pixel = render;
+    bus.ppu.framebuffer = frame;
     running = true;
     return true;
 }
 #else
 static const bool running = true;
+static bool no_idle_skip = false;  // --no-idle-skip, see NesCart.no_idle_loop_skip
 void load_rom(const char *romfile) {
     nes_cart_init(&bus.cart, romfile);
+    bus.cart.no_idle_loop_skip = no_idle_skip;
     nes_bus_init(&bus);
-    bus.ppu.draw_pixel = render;
+    bus.ppu.framebuffer = frame;
+    c6502_profile_init(&bus.cpu);  // if built with C6502_PROFILE
+}
+
+#define TRACE_RECORDS (1 << 20)
+
+/** keeps the last TRACE_RECORDS instructions in a file, for c6502_trace to print after a desync or crash */
+static void start_trace(const char *const tracefile) {
+    const size_t size = sizeof(C6502Trace) + TRACE_RECORDS * sizeof(C6502TraceRecord);
+    const int fd = open(tracefile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    void *const buf = (fd < 0) || (0 != ftruncate(fd, size))
+                          ? MAP_FAILED
+                          : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (fd >= 0) {
+        close(fd);  // the mapping stays
+    }
+    if (MAP_FAILED == buf) {
+        fprintf(stderr, "can't trace to %s\n", tracefile);
+        return;
+    }
+    c6502_trace_init(&bus.cpu, buf, size);
+}
+
+/** writes the cpu profile next to where we run, if there is one */
+static void dump_profile(void) {
+    static const struct {
+        const char *name;
+        C6502ProfileFormat format;
+    } files[] = {{"c6502_profile.csv", C6502_PROFILE_CSV}, {"c6502_profile.json", C6502_PROFILE_JSON}};
+    if (NULL == bus.cpu.profile) {
+        return;
+    }
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        FILE *const f = fopen(files[i].name, "w");
+        if (f) {
+            c6502_profile_dump(&bus.cpu, f, files[i].format, bus.cart.prg_rom.buf, bus.cart.prg_rom.size);
+            fclose(f);
+        }
+    }
 }
 #endif
 
@@ -177,16 +221,9 @@ static void main_loop(void) {
     }
 #endif
 
-    // for (int i = 0; i < 21477272 / 4; i++) {
-    //     nes_bus_cycle(&bus);
-    // }
     const uint32_t loop_start_ms = SDL_GetTicks();
-    while (bus.ppu.scanline == -1) {
-        nes_bus_cycle(&bus);
-    }
-    while (bus.ppu.scanline != -1) {
-        nes_bus_cycle(&bus);
-    }
+    nes_bus_run_frame(&bus);
+    c2C02_palette_convert(&palette, frame, scr, C2C02_WIDTH * C2C02_HEIGHT);
 
     SDL_UpdateTexture(s->texture, NULL, scr, sizeof(scr[0]));
     SDL_RenderCopy(s->renderer, s->texture, NULL, NULL);
@@ -202,14 +239,28 @@ static void main_loop(void) {
 #endif
 }
 
+// usage: sdl_pixel_graphics [--no-idle-skip] rom.nes [tracefile]
 EMSCRIPTEN_KEEPALIVE
 int main(int argc, char **argv) {
     (void)argc;
 #ifndef __EMSCRIPTEN__
-    load_rom(argv[1]);
+    int arg = 1;
+    if ((argc > arg) && (0 == strcmp(argv[arg], "--no-idle-skip"))) {
+        no_idle_skip = true;
+        arg++;
+    }
+    load_rom(argv[arg]);
+    if (argc > (arg + 1)) {
+        start_trace(argv[arg + 1]);
+    }
 #endif
 
     spg_init();
     emscripten_set_main_loop(main_loop, 60, 1);
+#ifndef __EMSCRIPTEN__
+    dump_profile();
+    nes_bus_deinit(&bus);
+    nes_cart_deinit(&bus.cart);
+#endif
     return 0;
 }
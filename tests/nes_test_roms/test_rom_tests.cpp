@@ -12,20 +12,23 @@ static const int ppu_cycles_per_sec = (21477272 / 4);
 TEST_GROUP(TestRomTests) {
     NesBus bus;
     TEST_SETUP() {
+        memset(&bus, 0, sizeof(bus));
         memset(bus.ram, 0xA3, sizeof(bus.ram));
     }
 
     TEST_TEARDOWN() {
         mock().checkExpectations();
         mock().clear();
+        nes_bus_deinit(&bus);
+        if (bus.cart.mapper) {
+            nes_cart_deinit(&bus.cart);
+        }
     }
 
     void test_vbl_nmi_timing(const char *const rom_file, float seconds) {
         nes_cart_init(&bus.cart, rom_file);
         nes_bus_init(&bus);
-        for (int i = 0; i < ppu_cycles_per_sec * seconds; i++) {
-            nes_bus_cycle(&bus);
-        }
+        nes_bus_run(&bus, ppu_cycles_per_sec * seconds);
 
         CHECK_EQUAL(bus.ram[0xF8], 1);
     }
@@ -63,9 +66,7 @@ TEST(TestRomTests, test_ppu_open_bus) {
     nes_cart_init(&bus.cart, ROMS_FOLDER "/nes-test-roms/ppu_open_bus/ppu_open_bus.nes");
     nes_bus_init(&bus);
     bus.cart.prg_ram.buf[0] = 0xFF;
-    for (int i = 0; i < ppu_cycles_per_sec * 5; i++) {
-        nes_bus_cycle(&bus);
-    }
+    nes_bus_run(&bus, ppu_cycles_per_sec * 5);
 
     CHECK_EQUAL(bus.cart.prg_ram.buf[0], 0);
 }
@@ -74,9 +75,7 @@ TEST(TestRomTests, test_cpu_dummy_writes_ppumem) {
     nes_cart_init(&bus.cart, ROMS_FOLDER "/nes-test-roms/cpu_dummy_writes/cpu_dummy_writes_ppumem.nes");
     nes_bus_init(&bus);
     bus.cart.prg_ram.buf[0] = 0xFF;
-    for (int i = 0; i < ppu_cycles_per_sec * 4; i++) {
-        nes_bus_cycle(&bus);
-    }
+    nes_bus_run(&bus, ppu_cycles_per_sec * 4);
 
     CHECK_EQUAL(bus.cart.prg_ram.buf[0], 0);
 }
@@ -1,44 +1,231 @@
-#include <assert.h>
 #include <c6502.h>
+#include <inttypes.h>
 #include <nes_bus.h>
 #include <nes_cart.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 // https://github.com/christopherpow/nes-test-roms/blob/master/other/nestest.log
+// usage: test_nestest <nestest.log> [runs]
+// Compares every instruction against the log as it starts, and stops at the first one that differs. Tracing keeps the
+// cpu stepping one instruction at a time, so nestest then runs again untraced, through the block cache (and the jit
+// when built with C6502_JIT), and only the state it ends in is compared. With more than one run it doubles as a
+// benchmark of the cpu core on the untraced path.
 
-static const int MAX_CYCLE_TIMEOUT = 100000;
 static const int TERMINATE_PC = 0x8000;
+static const int CONTEXT_LINES = 8;  // shown before a mismatch
 
 NesBus bus;
+static NesBus pristine;  // with the cart loaded, to start every run from
 
 #define c (bus.cpu)
-#define p (bus.ppu)
 
-int main(int, char *[]) {
-    nes_cart_init(&bus.cart, "nestest.nes");
-    nes_bus_init(&bus);
+/** the log as trace records, the same fields the cpu traces. Returns the number of lines */
+static size_t parse_log(const char *const path, C6502TraceRecord **const records) {
+    FILE *const f = fopen(path, "rt");
+    if (NULL == f) {
+        return 0;
+    }
+    size_t count = 0;
+    size_t capacity = 0;
+    *records = NULL;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (count == capacity) {
+            capacity = capacity ? (capacity * 2) : 0x4000;
+            C6502TraceRecord *const grown = realloc(*records, capacity * sizeof(**records));
+            if (NULL == grown) {
+                fprintf(stderr, "%s: out of memory at line %zu\n", path, count + 1);
+                exit(1);
+            }
+            *records = grown;
+        }
+        // "C000  4C F5 C5  JMP $C5F5 ...", the bytes by column, a mnemonic like ADC would pass for one
+        char bytes_column[10] = "";
+        unsigned pc, bytes[3] = {0};
+        unsigned a, x, y, p, sp;
+        int scanline, dot;
+        uint64_t cycle;
+        const char *const regs = strstr(line, "A:");
+        if (strlen(line) > 16) {
+            memcpy(bytes_column, &line[6], 9);
+        }
+        const int length = sscanf(bytes_column, "%2x %2x %2x", &bytes[0], &bytes[1], &bytes[2]);
+        if ((1 != sscanf(line, "%4x", &pc)) || (length < 1) || (NULL == regs) ||
+            (8 != sscanf(regs, "A:%2x X:%2x Y:%2x P:%2x SP:%2x PPU:%d,%d CYC:%" SCNu64, &a, &x, &y, &p, &sp,
+                         &scanline, &dot, &cycle))) {
+            fprintf(stderr, "%s:%zu: can't parse %s", path, count + 1, line);
+            exit(1);
+        }
+        (*records)[count++] = (C6502TraceRecord){
+            .cycle = cycle,
+            .pc = pc,
+            .scanline = scanline,
+            .dot = dot,
+            .bytes = {bytes[0], bytes[1], bytes[2]},
+            .length = length,
+            .a = a,
+            .x = x,
+            .y = y,
+            .p = p,
+            .sp = sp,
+        };
+    }
+    fclose(f);
+    return count;
+}
 
+/** names of the fields that differ, empty if none */
+static void mismatches(const C6502TraceRecord *const expected, const C6502TraceRecord *const actual, char *const out,
+                       const size_t size) {
+    out[0] = '\0';
+#define CHECK_FIELD(field, name)                        \
+    if (expected->field != actual->field) {             \
+        strncat(out, name " ", size - strlen(out) - 1); \
+    }
+    CHECK_FIELD(pc, "PC");
+    CHECK_FIELD(length, "length");
+    CHECK_FIELD(bytes[0], "opcode");
+    CHECK_FIELD(bytes[1], "operand");
+    CHECK_FIELD(bytes[2], "operand_hi");
+    CHECK_FIELD(a, "A");
+    CHECK_FIELD(x, "X");
+    CHECK_FIELD(y, "Y");
+    CHECK_FIELD(p, "P");
+    CHECK_FIELD(sp, "SP");
+    CHECK_FIELD(scanline, "scanline");
+    CHECK_FIELD(dot, "dot");
+    CHECK_FIELD(cycle, "CYC");
+#undef CHECK_FIELD
+}
+
+/** a fresh bus with nestest set up to start at $C000 once the reset sequence has run */
+static void setup(void) {
+    bus = pristine;
+    nes_bus_init(&bus);
     uint8_t *const mem = bus.ram;
     mem[0x100 + c.SP + 1] = (TERMINATE_PC - 1) & 0xFF;
     mem[0x100 + c.SP + 2] = (TERMINATE_PC - 1) >> 8;
-    c.PC = 0xC000;  // manually set PC for headless
-    c.SR.I = 1;     // ToDo - investigate
-    int i;
-    for (i = 0; i < MAX_CYCLE_TIMEOUT; i++) {
-        nes_bus_cycle(&bus);
-        if (bus.cpu.current_op_cycles_remaining) continue;
-        if (bus.cpu_subcycle_count != 0) continue;
-        if (TERMINATE_PC == c.PC) {
-            break;
+    c.PC = 0xC000;                                     // manually set PC for headless
+    c6502_set_status(&c, c6502_status(&c).u8 | 0x04);  // I. ToDo - investigate
+}
+
+/** false, with the results, if nestest didn't return to TERMINATE_PC with every test passed */
+static bool finished_cleanly(void) {
+    const uint8_t *const mem = bus.ram;
+    if ((TERMINATE_PC != c.PC) || (0 != mem[0x02]) || (0 != mem[0x03])) {
+        printf("nestest didn't finish cleanly: PC:%04X, results %02X %02X\n", c.PC, mem[0x02], mem[0x03]);
+        return false;
+    }
+    return true;
+}
+
+/** runs nestest once against the log, tracing every instruction. Returns the instructions run, 0 on a mismatch */
+static size_t run_traced(const C6502TraceRecord *const expected, const size_t count) {
+    static uint8_t trace_buf[sizeof(C6502Trace) + 16 * sizeof(C6502TraceRecord)] __attribute__((aligned(8)));
+
+    setup();
+    C6502Trace *const t = c6502_trace_init(&c, trace_buf, sizeof(trace_buf));
+    nes_bus_step(&bus);  // the reset sequence
+
+    size_t matched = count;
+    for (size_t i = 0; i < count; i++) {
+        nes_bus_step(&bus);  // traces instruction i as it starts
+        const C6502TraceRecord *const actual = &t->records[(t->written - 1) % t->capacity];
+        char fields[128];
+        mismatches(&expected[i], actual, fields, sizeof(fields));
+        if ('\0' == fields[0]) {
+            continue;
+        }
+        const size_t shown = (i < (size_t)CONTEXT_LINES) ? i : CONTEXT_LINES;
+        char line[128];
+        printf("mismatch at line %zu: %s\n", i + 1, fields);
+        for (size_t j = i - shown; j <= i; j++) {
+            c6502_trace_format(&expected[j], line, sizeof(line));
+            printf("%05zu expected: %s\n", j + 1, line);
+            c6502_trace_format(&t->records[(t->written - 1 - (i - j)) % t->capacity], line, sizeof(line));
+            printf("%05zu actual:   %s\n", j + 1, line);
+        }
+        matched = 0;
+        break;
+    }
+    c6502_trace_deinit(&c);
+    if (matched && !finished_cleanly()) {
+        matched = 0;
+    }
+    nes_bus_deinit(&bus);
+    return matched;
+}
+
+/** runs nestest once without tracing, up to where the log's last instruction starts, and compares the state there.
+ * Returns false on a mismatch */
+static bool run_untraced(const C6502TraceRecord *const last) {
+    setup();
+    nes_bus_run(&bus, last->cycle * NES_BUS_PPU_DOTS_PER_CPU_CYCLE);
+    const C6502TraceRecord actual = {
+        .cycle = c.total_cycles,
+        .pc = c.PC,
+        .scanline = bus.ppu.scanline,
+        .dot = bus.ppu.dot,
+        .bytes = {last->bytes[0], last->bytes[1], last->bytes[2]},  // the instruction itself isn't decoded here
+        .length = last->length,
+        .a = c.AC,
+        .x = c.X,
+        .y = c.Y,
+        .p = c6502_status(&c).u8,
+        .sp = c.SP,
+    };
+    char fields[128];
+    mismatches(last, &actual, fields, sizeof(fields));
+    bool ok = ('\0' == fields[0]);
+    if (!ok) {
+        char line[128];
+        printf("untraced run mismatch at the last line: %s\n", fields);
+        c6502_trace_format(last, line, sizeof(line));
+        printf("expected: %s\n", line);
+        c6502_trace_format(&actual, line, sizeof(line));
+        printf("actual:   %s\n", line);
+    } else {
+        nes_bus_step(&bus);  // the last instruction, returning to TERMINATE_PC
+        ok = finished_cleanly();
+    }
+    nes_bus_deinit(&bus);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <nestest.log> [runs]\n", argv[0]);
+        return 1;
+    }
+    C6502TraceRecord *expected;
+    const size_t count = parse_log(argv[1], &expected);
+    if (0 == count) {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+    nes_cart_init(&pristine.cart, "nestest.nes");
+
+    if (0 == run_traced(expected, count)) {
+        free(expected);
+        return 1;
+    }
+    const int runs = (argc > 2) ? atoi(argv[2]) : 1;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < runs; i++) {
+        if (!run_untraced(&expected[count - 1])) {
+            free(expected);
+            return 1;
         }
-        printf("%04X    A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%d,%d CYC:%d\n", c.PC, c.AC, c.X, c.Y, c.SR.u8, c.SP,
-               p.scanline, p.dot, c.total_cycles);
     }
-    assert(MAX_CYCLE_TIMEOUT != i);
-    assert(0 == mem[0x02]);
-    assert(0 == mem[0x03]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%zu instructions match, %d untraced run(s) in %.3fs: %.1f M instructions/s\n", count, runs, elapsed,
+           count * (double)runs / elapsed / 1e6);
+    free(expected);
     return 0;
-}
\ No newline at end of file
+}